@@ -0,0 +1,246 @@
+// ==========================================================================
+// Adaptive Bezier curve flattening on the CPU
+// ==========================================================================
+
+#include "BezierFlattener.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+// SIMD lanes: a minimal set of float vector operations for the kernels below
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+typedef __m256 Lane;
+static const int LANES = 8;
+static inline Lane LaneSet(float v)             { return _mm256_set1_ps(v); }
+static inline Lane LaneLoad(const float *p)     { return _mm256_loadu_ps(p); }
+static inline void LaneStore(float *p, Lane v)  { _mm256_storeu_ps(p, v); }
+static inline Lane LaneAdd(Lane a, Lane b)      { return _mm256_add_ps(a, b); }
+static inline Lane LaneSub(Lane a, Lane b)      { return _mm256_sub_ps(a, b); }
+static inline Lane LaneMul(Lane a, Lane b)      { return _mm256_mul_ps(a, b); }
+static inline Lane LaneMax(Lane a, Lane b)      { return _mm256_max_ps(a, b); }
+static inline Lane LaneMin(Lane a, Lane b)      { return _mm256_min_ps(a, b); }
+static inline Lane LaneSqrt(Lane a)             { return _mm256_sqrt_ps(a); }
+
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+
+#include <xmmintrin.h>
+typedef __m128 Lane;
+static const int LANES = 4;
+static inline Lane LaneSet(float v)             { return _mm_set1_ps(v); }
+static inline Lane LaneLoad(const float *p)     { return _mm_loadu_ps(p); }
+static inline void LaneStore(float *p, Lane v)  { _mm_storeu_ps(p, v); }
+static inline Lane LaneAdd(Lane a, Lane b)      { return _mm_add_ps(a, b); }
+static inline Lane LaneSub(Lane a, Lane b)      { return _mm_sub_ps(a, b); }
+static inline Lane LaneMul(Lane a, Lane b)      { return _mm_mul_ps(a, b); }
+static inline Lane LaneMax(Lane a, Lane b)      { return _mm_max_ps(a, b); }
+static inline Lane LaneMin(Lane a, Lane b)      { return _mm_min_ps(a, b); }
+static inline Lane LaneSqrt(Lane a)             { return _mm_sqrt_ps(a); }
+
+#else
+
+typedef float Lane;
+static const int LANES = 1;
+static inline Lane LaneSet(float v)             { return v; }
+static inline Lane LaneLoad(const float *p)     { return *p; }
+static inline void LaneStore(float *p, Lane v)  { *p = v; }
+static inline Lane LaneAdd(Lane a, Lane b)      { return a + b; }
+static inline Lane LaneSub(Lane a, Lane b)      { return a - b; }
+static inline Lane LaneMul(Lane a, Lane b)      { return a * b; }
+static inline Lane LaneMax(Lane a, Lane b)      { return a > b ? a : b; }
+static inline Lane LaneMin(Lane a, Lane b)      { return a < b ? a : b; }
+static inline Lane LaneSqrt(Lane a)             { return sqrt(a); }
+
+#endif
+
+// --------------------------------------------------------------------------
+// Queueing segments
+
+void BezierFlattener::AddCubic(float x0, float y0, float x1, float y1,
+                               float x2, float y2, float x3, float y3)
+{
+    m_x[0].push_back(x0);  m_y[0].push_back(y0);
+    m_x[1].push_back(x1);  m_y[1].push_back(y1);
+    m_x[2].push_back(x2);  m_y[2].push_back(y2);
+    m_x[3].push_back(x3);  m_y[3].push_back(y3);
+}
+
+void BezierFlattener::AddQuadratics(const float *v, size_t count)
+{
+    // degree elevation: the cubic's inner control points lie two thirds of
+    // the way from each end point towards the quadratic's control point
+    const float k = 2.0f / 3.0f;
+    for (size_t i = 0; i < count; ++i, v += 6)
+    {
+        AddCubic(v[0], v[1],
+                 v[0] + k * (v[2] - v[0]), v[1] + k * (v[3] - v[1]),
+                 v[4] + k * (v[2] - v[4]), v[5] + k * (v[3] - v[5]),
+                 v[4], v[5]);
+    }
+}
+
+void BezierFlattener::AddCubics(const float *v, size_t count)
+{
+    for (size_t i = 0; i < count; ++i, v += 8)
+        AddCubic(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+}
+
+void BezierFlattener::AddGlyph(const MyPackedGlyph &glyph, float dx, float dy, float scale)
+{
+    for (unsigned int s = 0; s < glyph.segmentCount; ++s)
+    {
+        // transform the segment's control points
+        const float *p = glyph.points + 2 * glyph.segments[s];
+        unsigned int degree = glyph.degrees[s];
+        float v[8];
+        for (unsigned int i = 0; i <= degree && i < 4; ++i) {
+            v[2*i] = p[2*i] * scale + dx;
+            v[2*i+1] = p[2*i+1] * scale + dy;
+        }
+
+        if (degree == 1) {
+            m_lines.insert(m_lines.end(), v, v + 4);
+        }
+        else if (degree == 2) {
+            AddQuadratics(v, 1);
+        }
+        else if (degree == 3) {
+            AddCubics(v, 1);
+        }
+    }
+}
+
+void BezierFlattener::Clear()
+{
+    for (int i = 0; i < 4; ++i) {
+        m_x[i].clear();
+        m_y[i].clear();
+    }
+    m_lines.clear();
+}
+
+// --------------------------------------------------------------------------
+// Flattening
+
+void BezierFlattener::Flatten(float tolerance, vector<float> &lines)
+{
+    size_t count = CurveCount();
+
+    // pad the queue to whole lanes with degenerate curves, which get one piece
+    // each and are never written out
+    size_t padded = (count + LANES - 1) / LANES * LANES;
+    for (int i = 0; i < 4; ++i) {
+        m_x[i].resize(padded, 0.0f);
+        m_y[i].resize(padded, 0.0f);
+    }
+
+    // A cubic's second derivative is bounded by 6 M, where M is the longest
+    // second difference of its control points. Splitting it into n equal
+    // parameter steps keeps every chord within 6 M / (8 n^2) of the curve, so
+    // n = sqrt(3 M / (4 tolerance)) pieces are enough. Unlike the tessellator,
+    // nothing limits n here, so it is left as large as the tolerance needs.
+    m_pieces.resize(padded);
+    Lane scale = LaneSet(0.75f / max(tolerance, 1e-12f));
+    Lane two = LaneSet(2.0f);
+    for (size_t c = 0; c < padded; c += LANES)
+    {
+        Lane x0 = LaneLoad(&m_x[0][c]), y0 = LaneLoad(&m_y[0][c]);
+        Lane x1 = LaneLoad(&m_x[1][c]), y1 = LaneLoad(&m_y[1][c]);
+        Lane x2 = LaneLoad(&m_x[2][c]), y2 = LaneLoad(&m_y[2][c]);
+        Lane x3 = LaneLoad(&m_x[3][c]), y3 = LaneLoad(&m_y[3][c]);
+
+        Lane ax = LaneAdd(LaneSub(x0, LaneMul(two, x1)), x2);
+        Lane ay = LaneAdd(LaneSub(y0, LaneMul(two, y1)), y2);
+        Lane bx = LaneAdd(LaneSub(x1, LaneMul(two, x2)), x3);
+        Lane by = LaneAdd(LaneSub(y1, LaneMul(two, y2)), y3);
+        Lane m = LaneMax(LaneAdd(LaneMul(ax, ax), LaneMul(ay, ay)),
+                         LaneAdd(LaneMul(bx, bx), LaneMul(by, by)));
+        Lane n = LaneSqrt(LaneMul(LaneSqrt(m), scale));
+
+        // the bound only keeps the conversion defined; no curve that fits
+        // in memory gets near it, and a NaN gets a single piece
+        float pieces[LANES];
+        LaneStore(pieces, n);
+        for (int l = 0; l < LANES; ++l)
+            m_pieces[c + l] = pieces[l] >= 1.0f ? static_cast<int>(ceil(min(pieces[l], 1e9f))) : 1;
+    }
+
+    // every piece is one line, written as two vertices of two floats each;
+    // straight segments are copied through unchanged
+    m_offsets.resize(padded);
+    size_t begin = lines.size();
+    size_t total = m_lines.size();
+    for (size_t c = 0; c < count; ++c) {
+        m_offsets[c] = begin + total;
+        total += 4 * m_pieces[c];
+    }
+    lines.resize(begin + total);
+    if (!m_lines.empty())
+        copy(m_lines.begin(), m_lines.end(), lines.begin() + begin);
+
+    // evaluate LANES curves at once at parameter t = k / n, with each lane
+    // stopping at its own n
+    for (size_t c = 0; c < count; c += LANES)
+    {
+        Lane x0 = LaneLoad(&m_x[0][c]), y0 = LaneLoad(&m_y[0][c]);
+        Lane x1 = LaneLoad(&m_x[1][c]), y1 = LaneLoad(&m_y[1][c]);
+        Lane x2 = LaneLoad(&m_x[2][c]), y2 = LaneLoad(&m_y[2][c]);
+        Lane x3 = LaneLoad(&m_x[3][c]), y3 = LaneLoad(&m_y[3][c]);
+
+        int lanes = static_cast<int>(min<size_t>(LANES, count - c));
+        int steps = 0;
+        float step[LANES];
+        for (int l = 0; l < LANES; ++l) {
+            step[l] = 1.0f / m_pieces[c + l];
+            if (l < lanes) steps = max(steps, m_pieces[c + l]);
+        }
+        Lane one = LaneSet(1.0f);
+        Lane three = LaneSet(3.0f);
+
+        float px[LANES], py[LANES];
+        LaneStore(px, x0);
+        LaneStore(py, y0);
+
+        for (int k = 1; k <= steps; ++k)
+        {
+            // Bernstein form; each curve's last piece ends at exactly t = 1,
+            // which lands on its end point, and finished lanes stay there
+            float times[LANES];
+            for (int l = 0; l < LANES; ++l)
+                times[l] = k < m_pieces[c + l] ? k * step[l] : 1.0f;
+            Lane t = LaneLoad(times);
+            Lane s = LaneSub(one, t);
+            Lane b0 = LaneMul(LaneMul(s, s), s);
+            Lane b1 = LaneMul(three, LaneMul(LaneMul(s, s), t));
+            Lane b2 = LaneMul(three, LaneMul(LaneMul(s, t), t));
+            Lane b3 = LaneMul(LaneMul(t, t), t);
+            Lane x = LaneAdd(LaneAdd(LaneMul(b0, x0), LaneMul(b1, x1)),
+                             LaneAdd(LaneMul(b2, x2), LaneMul(b3, x3)));
+            Lane y = LaneAdd(LaneAdd(LaneMul(b0, y0), LaneMul(b1, y1)),
+                             LaneAdd(LaneMul(b2, y2), LaneMul(b3, y3)));
+
+            float qx[LANES], qy[LANES];
+            LaneStore(qx, x);
+            LaneStore(qy, y);
+
+            // scatter each active lane's line into its own output range
+            for (int l = 0; l < lanes; ++l)
+            {
+                if (k > m_pieces[c + l]) continue;
+                float *out = &lines[m_offsets[c + l] + 4 * (k - 1)];
+                out[0] = px[l];  out[1] = py[l];
+                out[2] = qx[l];  out[3] = qy[l];
+                px[l] = qx[l];
+                py[l] = qy[l];
+            }
+        }
+    }
+
+    Clear();
+}
+
+// --------------------------------------------------------------------------
@@ -0,0 +1,60 @@
+// ==========================================================================
+// Adaptive Bezier curve flattening on the CPU
+//
+// Converts quadratic and cubic Bezier segments into line segments that stay
+// within a given distance of the true curve. Each curve gets as many pieces
+// as its size and curvature need, rather than a fixed count, so small or
+// nearly straight curves cost a single line. Curves are processed several at
+// a time with SIMD kernels (AVX when compiled with it, otherwise SSE, with a
+// scalar fallback elsewhere). Output is written as GL_LINES vertex pairs.
+//
+// This gives a rendering path for OpenGL contexts without tessellation
+// shaders, and curve geometry for the software rasterizer.
+// ==========================================================================
+#ifndef BEZIERFLATTENER_H
+#define BEZIERFLATTENER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "GlyphExtractor.h"
+
+class BezierFlattener
+{
+    // curves queued for flattening, stored as cubics in structure-of-arrays
+    // form (one array per coordinate) so that the kernels can load them
+    // directly; quadratics are raised to cubics, which is exact
+    std::vector<float> m_x[4];
+    std::vector<float> m_y[4];
+
+    // straight segments queued as x0, y0, x1, y1
+    std::vector<float> m_lines;
+
+    // piece count and output position per curve, reused between calls
+    std::vector<int> m_pieces;
+    std::vector<size_t> m_offsets;
+
+    void AddCubic(float x0, float y0, float x1, float y1,
+                  float x2, float y2, float x3, float y3);
+
+public:
+    // queue curves from flat vertex arrays (x,y pairs, 3 or 4 per curve)
+    void AddQuadratics(const float *vertices, size_t count);
+    void AddCubics(const float *vertices, size_t count);
+
+    // queue every segment of a glyph, translated by (dx, dy) and scaled by scale
+    void AddGlyph(const MyPackedGlyph &glyph, float dx, float dy, float scale = 1.0f);
+
+    // number of curves queued
+    size_t CurveCount() const   { return m_x[0].size(); }
+
+    // appends line vertex pairs approximating every queued segment to within
+    // tolerance (in the same units as the input) and clears the queue
+    void Flatten(float tolerance, std::vector<float> &lines);
+
+    // discards everything queued
+    void Clear();
+};
+
+// --------------------------------------------------------------------------
+#endif // BEZIERFLATTENER_H
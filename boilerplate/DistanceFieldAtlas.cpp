@@ -0,0 +1,482 @@
+// ==========================================================================
+// Signed distance field glyph atlases
+// ==========================================================================
+
+#include "DistanceFieldAtlas.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+// size of the grid cells segments are binned into, in texels
+const int CELL = 8;
+
+// a segment in texel coordinates, as a polynomial in power form
+// (c[0] + c[1] t + c[2] t^2 + c[3] t^3) with its control point bounds
+struct Segment
+{
+    int     degree;
+    float   x[4];
+    float   y[4];
+    float   box[4];
+};
+
+// real roots of a t^2 + b t + c, returning how many there are
+int SolveQuadratic(double a, double b, double c, double roots[2])
+{
+    if (a == 0.0 || fabs(b) > 1e6 * fabs(a)) {
+        if (b == 0.0) return 0;
+        roots[0] = -c / b;
+        return 1;
+    }
+    double discriminant = b * b - 4.0 * a * c;
+    if (discriminant < 0.0) return 0;
+    if (discriminant == 0.0) {
+        roots[0] = -b / (2.0 * a);
+        return 1;
+    }
+    double s = sqrt(discriminant);
+    roots[0] = (-b + s) / (2.0 * a);
+    roots[1] = (-b - s) / (2.0 * a);
+    return 2;
+}
+
+// real roots of a t^3 + b t^2 + c t + d, returning how many there are
+int SolveCubic(double a, double b, double c, double d, double roots[3])
+{
+    // nearly quadratic; the cubic formula loses all precision here
+    if (a == 0.0 || fabs(b) > 1e6 * fabs(a))
+        return SolveQuadratic(b, c, d, roots);
+
+    b /= a; c /= a; d /= a;
+    double q = (b * b - 3.0 * c) / 9.0;
+    double r = (b * (2.0 * b * b - 9.0 * c) + 27.0 * d) / 54.0;
+    double r2 = r * r, q3 = q * q * q;
+    b /= 3.0;
+
+    if (r2 < q3) {
+        // three real roots
+        double theta = acos(max(-1.0, min(1.0, r / sqrt(q3))));
+        double m = -2.0 * sqrt(q);
+        const double third = 2.0943951023931953;    // 2 pi / 3
+        roots[0] = m * cos(theta / 3.0) - b;
+        roots[1] = m * cos(theta / 3.0 + third) - b;
+        roots[2] = m * cos(theta / 3.0 - third) - b;
+        return 3;
+    }
+
+    double A = -pow(fabs(r) + sqrt(r2 - q3), 1.0 / 3.0);
+    if (r < 0.0) A = -A;
+    double B = A == 0.0 ? 0.0 : q / A;
+    roots[0] = (A + B) - b;
+    if (fabs(A - B) < 1e-12 * fabs(A)) {
+        roots[1] = -0.5 * (A + B) - b;
+        return 2;
+    }
+    return 1;
+}
+
+inline float Evaluate(const float *c, float t)
+{
+    return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+}
+
+inline float Derivative(const float *c, float t)
+{
+    return c[1] + t * (2.0f * c[2] + t * 3.0f * c[3]);
+}
+
+// squared distance from (px, py) to a segment
+float SquaredDistance(const Segment &s, float px, float py)
+{
+    float best;
+    float dx0 = s.x[0] - px, dy0 = s.y[0] - py;
+
+    if (s.degree == 1)
+    {
+        // project onto the line and clamp to its ends
+        float lengthSquared = s.x[1] * s.x[1] + s.y[1] * s.y[1];
+        float t = lengthSquared > 0.0f ? -(dx0 * s.x[1] + dy0 * s.y[1]) / lengthSquared : 0.0f;
+        t = min(max(t, 0.0f), 1.0f);
+        float dx = dx0 + t * s.x[1], dy = dy0 + t * s.y[1];
+        return dx * dx + dy * dy;
+    }
+
+    // the ends are always candidates
+    float dx1 = Evaluate(s.x, 1.0f) - px, dy1 = Evaluate(s.y, 1.0f) - py;
+    best = min(dx0 * dx0 + dy0 * dy0, dx1 * dx1 + dy1 * dy1);
+
+    if (s.degree == 2)
+    {
+        // the closest interior point is where (B(t) - p) . B'(t) = 0, a cubic
+        double roots[3];
+        int count = SolveCubic(
+            2.0 * (s.x[2] * s.x[2] + s.y[2] * s.y[2]),
+            3.0 * (s.x[1] * s.x[2] + s.y[1] * s.y[2]),
+            s.x[1] * s.x[1] + s.y[1] * s.y[1] + 2.0 * (dx0 * s.x[2] + dy0 * s.y[2]),
+            dx0 * s.x[1] + dy0 * s.y[1], roots);
+        for (int i = 0; i < count; ++i) {
+            if (roots[i] <= 0.0 || roots[i] >= 1.0) continue;
+            float t = float(roots[i]);
+            float dx = Evaluate(s.x, t) - px, dy = Evaluate(s.y, t) - py;
+            best = min(best, dx * dx + dy * dy);
+        }
+        return best;
+    }
+
+    // cubics lead to a quintic, so refine several starting points with
+    // Newton's method instead
+    const int STARTS = 5, STEPS = 5;
+    for (int i = 0; i < STARTS; ++i)
+    {
+        float t = float(i) / (STARTS - 1);
+        for (int step = 0; step < STEPS; ++step)
+        {
+            float dx = Evaluate(s.x, t) - px, dy = Evaluate(s.y, t) - py;
+            float ddx = Derivative(s.x, t), ddy = Derivative(s.y, t);
+            float d2x = 2.0f * s.x[2] + 6.0f * s.x[3] * t;
+            float d2y = 2.0f * s.y[2] + 6.0f * s.y[3] * t;
+            float f = dx * ddx + dy * ddy;
+            float df = ddx * ddx + ddy * ddy + dx * d2x + dy * d2y;
+            if (df == 0.0f) break;
+            t = min(max(t - f / df, 0.0f), 1.0f);
+        }
+        float dx = Evaluate(s.x, t) - px, dy = Evaluate(s.y, t) - py;
+        best = min(best, dx * dx + dy * dy);
+    }
+    return best;
+}
+
+// a place where a scanline crosses the outline, and which way it goes
+struct Crossing
+{
+    float   x;
+    int     direction;
+
+    bool operator<(const Crossing &other) const { return x < other.x; }
+};
+
+// appends where a segment crosses the horizontal line y = row; each root is
+// counted on t in [0, 1), so shared end points are only counted once
+void AddCrossings(const Segment &s, float row, vector<Crossing> &crossings)
+{
+    if (row < s.box[1] || row > s.box[3])
+        return;
+
+    double roots[3];
+    int count = SolveCubic(s.y[3], s.y[2], s.y[1], s.y[0] - row, roots);
+    for (int i = 0; i < count; ++i)
+    {
+        if (roots[i] < 0.0 || roots[i] >= 1.0) continue;
+        float t = float(roots[i]);
+        float dy = Derivative(s.y, t);
+        if (dy == 0.0f) continue;
+
+        Crossing crossing;
+        crossing.x = Evaluate(s.x, t);
+        crossing.direction = dy > 0.0f ? 1 : -1;
+        crossings.push_back(crossing);
+    }
+}
+
+// renders one glyph's distance field into a width x height bitmap, with the
+// glyph's bounding box inset by pad texels
+void RenderGlyph(const MyPackedGlyph &glyph, float pixelsPerEm, float range, int pad,
+                 int width, int height, unsigned char *texels)
+{
+    // convert the segments to texel coordinates (rows down) in power form
+    vector<Segment> segments(glyph.segmentCount);
+    for (unsigned int i = 0; i < glyph.segmentCount; ++i)
+    {
+        const float *p = glyph.points + 2 * glyph.segments[i];
+        Segment &s = segments[i];
+        s.degree = min<int>(max<int>(glyph.degrees[i], 1), 3);
+
+        float x[4], y[4];
+        for (int j = 0; j <= s.degree; ++j) {
+            x[j] = (p[2*j] - glyph.bounds[0]) * pixelsPerEm + pad;
+            y[j] = (glyph.bounds[3] - p[2*j+1]) * pixelsPerEm + pad;
+        }
+        s.box[0] = *min_element(x, x + s.degree + 1);
+        s.box[1] = *min_element(y, y + s.degree + 1);
+        s.box[2] = *max_element(x, x + s.degree + 1);
+        s.box[3] = *max_element(y, y + s.degree + 1);
+
+        float *c[2] = { s.x, s.y };
+        float *v[2] = { x, y };
+        for (int k = 0; k < 2; ++k) {
+            float *a = v[k];
+            if (s.degree == 1) {
+                c[k][0] = a[0]; c[k][1] = a[1] - a[0]; c[k][2] = 0.0f; c[k][3] = 0.0f;
+            }
+            else if (s.degree == 2) {
+                c[k][0] = a[0]; c[k][1] = 2.0f * (a[1] - a[0]);
+                c[k][2] = a[0] - 2.0f * a[1] + a[2]; c[k][3] = 0.0f;
+            }
+            else {
+                c[k][0] = a[0]; c[k][1] = 3.0f * (a[1] - a[0]);
+                c[k][2] = 3.0f * (a[0] - 2.0f * a[1] + a[2]);
+                c[k][3] = -a[0] + 3.0f * a[1] - 3.0f * a[2] + a[3];
+            }
+        }
+    }
+
+    // bin each segment into every cell it could be within range of
+    int columns = (width + CELL - 1) / CELL;
+    int rows = (height + CELL - 1) / CELL;
+    vector<vector<unsigned int> > cells(columns * rows);
+    for (unsigned int i = 0; i < segments.size(); ++i)
+    {
+        const float *box = segments[i].box;
+        int c0 = max(0, int(floor((box[0] - range) / CELL)));
+        int r0 = max(0, int(floor((box[1] - range) / CELL)));
+        int c1 = min(columns - 1, int(floor((box[2] + range) / CELL)));
+        int r1 = min(rows - 1, int(floor((box[3] + range) / CELL)));
+        for (int r = r0; r <= r1; ++r)
+            for (int c = c0; c <= c1; ++c)
+                cells[r * columns + c].push_back(i);
+    }
+
+    vector<Crossing> crossings;
+    for (int j = 0; j < height; ++j)
+    {
+        // inside is decided by the non-zero winding rule along each row; the
+        // row is nudged off the texel centres so it never passes exactly
+        // through an end point
+        float row = j + 0.5f + 1.0f / 1024.0f;
+        crossings.clear();
+        for (size_t i = 0; i < segments.size(); ++i)
+            AddCrossings(segments[i], row, crossings);
+        sort(crossings.begin(), crossings.end());
+
+        size_t next = 0;
+        int winding = 0;
+        for (int i = 0; i < width; ++i)
+        {
+            float px = i + 0.5f, py = j + 0.5f;
+            for (; next < crossings.size() && crossings[next].x < px; ++next)
+                winding += crossings[next].direction;
+
+            // nearest segment, skipping those whose bounds are already too far
+            float best = range * range;
+            const vector<unsigned int> &cell = cells[(j / CELL) * columns + i / CELL];
+            for (size_t k = 0; k < cell.size(); ++k)
+            {
+                const Segment &s = segments[cell[k]];
+                float dx = max(max(s.box[0] - px, px - s.box[2]), 0.0f);
+                float dy = max(max(s.box[1] - py, py - s.box[3]), 0.0f);
+                if (dx * dx + dy * dy >= best) continue;
+                best = min(best, SquaredDistance(s, px, py));
+            }
+
+            float distance = sqrt(best);
+            if (winding == 0) distance = -distance;
+            float value = 0.5f + 0.5f * distance / range;
+            texels[j * width + i] = static_cast<unsigned char>(min(max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+} // namespace
+
+string DistanceFieldAtlasFilename(const string &fontFilename)
+{
+    return fontFilename + ".sdf";
+}
+
+// --------------------------------------------------------------------------
+
+DistanceFieldAtlas::DistanceFieldAtlas()
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+bool DistanceFieldAtlas::Generate(const GlyphExtractor &extractor, int first, int last,
+                                  float pixelsPerEm, float range, unsigned int threads)
+{
+    FontHandle font = extractor.CurrentFont();
+    if (font < 0) {
+        cout << "DistanceFieldAtlas ERROR: No font loaded!" << endl;
+        return false;
+    }
+
+    vector<int> characters = extractor.CharacterCodes();
+    characters.erase(remove_if(characters.begin(), characters.end(),
+        [=](int c) { return c < first || c > last; }), characters.end());
+    vector<MyPackedGlyphStorage> glyphs = extractor.ExtractGlyphs(characters, threads);
+    if (glyphs.size() != characters.size())
+        return false;
+
+    // size every glyph's bitmap, leaving room for the distance to fall off
+    int pad = int(ceil(range)) + 1;
+    m_glyphs.assign(characters.size(), DistanceFieldGlyph());
+    for (size_t i = 0; i < characters.size(); ++i)
+    {
+        MyPackedGlyph glyph = glyphs[i].View();
+        DistanceFieldGlyph &entry = m_glyphs[i];
+        entry.character = static_cast<unsigned int>(characters[i]);
+        entry.advance = glyph.advance;
+        entry.x = entry.y = entry.width = entry.height = 0;
+        for (int j = 0; j < 4; ++j)
+            entry.bounds[j] = 0.0f;
+        if (glyph.segmentCount == 0)
+            continue;
+
+        entry.width = static_cast<unsigned int>(ceil((glyph.bounds[2] - glyph.bounds[0]) * pixelsPerEm)) + 2 * pad;
+        entry.height = static_cast<unsigned int>(ceil((glyph.bounds[3] - glyph.bounds[1]) * pixelsPerEm)) + 2 * pad;
+        entry.bounds[0] = glyph.bounds[0] - pad / pixelsPerEm;
+        entry.bounds[3] = glyph.bounds[3] + pad / pixelsPerEm;
+        entry.bounds[2] = entry.bounds[0] + entry.width / pixelsPerEm;
+        entry.bounds[1] = entry.bounds[3] - entry.height / pixelsPerEm;
+    }
+
+    // render the glyphs on every thread, one at a time since they are costly
+    vector<vector<unsigned char> > bitmaps(characters.size());
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < characters.size(); i = next++) {
+            const DistanceFieldGlyph &entry = m_glyphs[i];
+            bitmaps[i].resize(entry.width * entry.height);
+            if (!bitmaps[i].empty())
+                RenderGlyph(glyphs[i].View(), pixelsPerEm, range, pad,
+                            entry.width, entry.height, &bitmaps[i][0]);
+        }
+    };
+
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    vector<thread> pool;
+    for (unsigned int i = 1; i < threads; ++i)
+        pool.push_back(thread(worker));
+    worker();
+    for (size_t i = 0; i < pool.size(); ++i)
+        pool[i].join();
+
+    // pack onto shelves, tallest glyphs first, in a power of two wide atlas
+    // roughly as tall as it is wide
+    vector<size_t> order(m_glyphs.size());
+    size_t area = 0;
+    unsigned int widest = 1;
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+        area += m_glyphs[i].width * m_glyphs[i].height;
+        widest = max(widest, m_glyphs[i].width);
+    }
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return m_glyphs[a].height > m_glyphs[b].height;
+    });
+
+    unsigned int width = 1;
+    while (width < widest || size_t(width) * width < area)
+        width *= 2;
+
+    unsigned int x = 0, y = 0, shelf = 0;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        DistanceFieldGlyph &entry = m_glyphs[order[i]];
+        if (entry.width == 0) continue;
+        if (x + entry.width > width) {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        entry.x = x;
+        entry.y = y;
+        x += entry.width;
+        shelf = max(shelf, entry.height);
+    }
+    unsigned int height = y + shelf;
+
+    m_pixels.assign(size_t(width) * height, 0);
+    for (size_t i = 0; i < m_glyphs.size(); ++i)
+    {
+        const DistanceFieldGlyph &entry = m_glyphs[i];
+        for (unsigned int row = 0; row < entry.height; ++row)
+            copy(bitmaps[i].begin() + row * entry.width, bitmaps[i].begin() + (row + 1) * entry.width,
+                 m_pixels.begin() + (entry.y + row) * width + entry.x);
+    }
+
+    memcpy(m_header.magic, "GSDF", 4);
+    m_header.version = DISTANCE_FIELD_ATLAS_VERSION;
+    m_header.sourceHash = extractor.Registry().Hash(font);
+    m_header.first = static_cast<unsigned int>(first);
+    m_header.last = static_cast<unsigned int>(last);
+    m_header.pixelsPerEm = pixelsPerEm;
+    m_header.range = range;
+    m_header.width = width;
+    m_header.height = height;
+    m_header.glyphCount = static_cast<unsigned int>(m_glyphs.size());
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool DistanceFieldAtlas::Save(const string &filename) const
+{
+    ofstream output(filename.c_str(), ios::binary);
+    if (!output) {
+        cout << "DistanceFieldAtlas ERROR: could not write " << filename << endl;
+        return false;
+    }
+
+    output.write(reinterpret_cast<const char *>(&m_header), sizeof(m_header));
+    if (!m_glyphs.empty())
+        output.write(reinterpret_cast<const char *>(&m_glyphs[0]), m_glyphs.size() * sizeof(DistanceFieldGlyph));
+    if (!m_pixels.empty())
+        output.write(reinterpret_cast<const char *>(&m_pixels[0]), m_pixels.size());
+
+    return output.good();
+}
+
+bool DistanceFieldAtlas::Load(const string &filename, unsigned long long sourceHash, int first, int last,
+                              float pixelsPerEm, float range)
+{
+    ifstream input(filename.c_str(), ios::binary);
+    if (!input)
+        return false;
+
+    // only an atlas built the same way from the same font will do
+    DistanceFieldAtlasHeader header;
+    if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, "GSDF", 4) != 0 ||
+        header.version != DISTANCE_FIELD_ATLAS_VERSION ||
+        header.sourceHash != sourceHash ||
+        header.first != static_cast<unsigned int>(first) ||
+        header.last != static_cast<unsigned int>(last) ||
+        header.pixelsPerEm != pixelsPerEm || header.range != range)
+        return false;
+
+    vector<DistanceFieldGlyph> glyphs(header.glyphCount);
+    vector<unsigned char> pixels(size_t(header.width) * header.height);
+    if ((!glyphs.empty() && !input.read(reinterpret_cast<char *>(&glyphs[0]),
+                                        glyphs.size() * sizeof(DistanceFieldGlyph))) ||
+        (!pixels.empty() && !input.read(reinterpret_cast<char *>(&pixels[0]), pixels.size())))
+    {
+        cout << "DistanceFieldAtlas ERROR: " << filename << " is truncated" << endl;
+        return false;
+    }
+
+    m_header = header;
+    m_glyphs.swap(glyphs);
+    m_pixels.swap(pixels);
+    return true;
+}
+
+const DistanceFieldGlyph *DistanceFieldAtlas::Find(int character) const
+{
+    // glyphs are kept in the font's character order, which is increasing
+    vector<DistanceFieldGlyph>::const_iterator entry = lower_bound(m_glyphs.begin(), m_glyphs.end(),
+        static_cast<unsigned int>(character),
+        [](const DistanceFieldGlyph &glyph, unsigned int c) { return glyph.character < c; });
+    if (entry == m_glyphs.end() || entry->character != static_cast<unsigned int>(character))
+        return 0;
+    return &*entry;
+}
@@ -0,0 +1,102 @@
+// ==========================================================================
+// Signed distance field glyph atlases
+//
+// Renders a range of characters as signed distance fields and packs them
+// into a single-channel texture atlas with a table of glyph metrics, for
+// text that stays sharp at any scale. Each texel holds the distance to the
+// nearest point of the outline (exact for lines, quadratics and cubics),
+// clamped to a range and mapped so that 0.5 lies on the edge and larger
+// values are inside. Segments are binned into a grid over each glyph, so a
+// texel only measures the segments that can be within range of it, and
+// glyphs are spread over threads.
+//
+// Atlases are slow enough to build that they are cached on disk; the cache
+// file layout (native byte order) is:
+//  - DistanceFieldAtlasHeader
+//  - glyphCount DistanceFieldGlyph records, sorted by character
+//  - width * height bytes of distance, top row first
+// ==========================================================================
+#ifndef DISTANCEFIELDATLAS_H
+#define DISTANCEFIELDATLAS_H
+
+#include <string>
+#include <vector>
+
+#include "GlyphExtractor.h"
+
+// --------------------------------------------------------------------------
+// File structures
+
+struct DistanceFieldAtlasHeader
+{
+    char            magic[4];       // "GSDF"
+    unsigned int    version;        // DISTANCE_FIELD_ATLAS_VERSION
+    unsigned long long sourceHash;  // FontRegistry::Hash of the font file it was built from
+    unsigned int    first;          // range of characters requested
+    unsigned int    last;
+    float           pixelsPerEm;
+    float           range;          // distance at which values saturate, in texels
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    glyphCount;
+};
+
+struct DistanceFieldGlyph
+{
+    unsigned int    character;
+    float           advance;        // in EM units
+
+    // the quad to draw the glyph's texels on, relative to the glyph origin
+    // (left, bottom, right, top), in EM units
+    float           bounds[4];
+
+    // where the glyph's texels are in the atlas; empty for blank glyphs
+    unsigned int    x;
+    unsigned int    y;
+    unsigned int    width;
+    unsigned int    height;
+};
+
+// raised whenever the glyphs come out differently, so older atlases rebuild
+const unsigned int DISTANCE_FIELD_ATLAS_VERSION = 3;
+
+// file name of the cached atlas that belongs to a font file
+std::string DistanceFieldAtlasFilename(const std::string &fontFilename);
+
+// --------------------------------------------------------------------------
+// This class generates, saves and loads distance field atlases.
+
+class DistanceFieldAtlas
+{
+    DistanceFieldAtlasHeader        m_header;
+    std::vector<DistanceFieldGlyph> m_glyphs;
+    std::vector<unsigned char>      m_pixels;
+
+public:
+    DistanceFieldAtlas();
+
+    // renders every character in [first, last] that the extractor's current
+    // font has, spreading glyphs over the given number of threads (0 = one
+    // per core), returning true if successful
+    bool Generate(const GlyphExtractor &extractor, int first, int last,
+                  float pixelsPerEm, float range, unsigned int threads = 0);
+
+    // writes the atlas to a cache file, returning true if successful
+    bool Save(const std::string &filename) const;
+
+    // reads a cache file, rejecting it unless it was built by this version
+    // with the same parameters from a font file with the given hash
+    bool Load(const std::string &filename, unsigned long long sourceHash, int first, int last,
+              float pixelsPerEm, float range);
+
+    // looks up the metrics for a character, or 0 if it is not in the atlas
+    const DistanceFieldGlyph *Find(int character) const;
+
+    unsigned int Width() const                              { return m_header.width; }
+    unsigned int Height() const                             { return m_header.height; }
+    const std::vector<unsigned char> &Pixels() const        { return m_pixels; }
+    const std::vector<DistanceFieldGlyph> &Glyphs() const   { return m_glyphs; }
+};
+
+// --------------------------------------------------------------------------
+#endif // DISTANCEFIELDATLAS_H
@@ -0,0 +1,180 @@
+// ==========================================================================
+// Background font loading
+// ==========================================================================
+
+#include "FontLoader.h"
+#include "Profiler.h"
+#include <algorithm>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+FontLoader::FontLoader()
+    : m_front(0), m_ready(false), m_requested(0), m_started(0), m_stopping(false),
+      m_preloading(0), m_preloadCancelled(false)
+{
+    m_preloaded[0] = m_preloaded[1] = 0.0;
+    m_preloadedAll[0] = m_preloadedAll[1] = false;
+}
+
+FontLoader::~FontLoader()
+{
+    Stop();
+}
+
+void FontLoader::Preload(const vector<string> &filenames, const string &characters)
+{
+    if (m_preloading.load() > 0 || m_worker.joinable())
+        return;
+    for (int i = 0; i < 2; ++i) {
+        if (m_preloaders[i].joinable())
+            m_preloaders[i].join();
+    }
+
+    m_preloadFonts = filenames;
+    m_preloadCharacters = characters;
+    m_preloadStart = chrono::steady_clock::now();
+    m_preloadCancelled.store(false);
+    m_preloading.store(2);
+    for (int i = 0; i < 2; ++i)
+        m_preloaders[i] = thread(&FontLoader::PreloadSlot, this, i);
+}
+
+double FontLoader::PreloadSeconds() const
+{
+    return Preloading() ? 0.0 : max(m_preloaded[0], m_preloaded[1]);
+}
+
+bool FontLoader::PreloadCancelled() const
+{
+    return !Preloading() && !(m_preloadedAll[0] && m_preloadedAll[1]);
+}
+
+void FontLoader::PreloadSlot(int slot)
+{
+    Profiler::NameThread("font preloader");
+    PROFILE_SCOPE("Preload fonts");
+
+    // a request gives up the rest of the preload, finishing no more than
+    // the glyph under way
+    GlyphExtractor &extractor = m_slots[slot].extractor;
+    for (size_t i = 0; i < m_preloadFonts.size() && !m_preloadCancelled.load(); ++i)
+    {
+        if (!extractor.LoadFontFile(m_preloadFonts[i]))
+            continue;
+        for (size_t j = 0; j < m_preloadCharacters.size() && !m_preloadCancelled.load(); ++j)
+            extractor.ExtractPackedGlyph(static_cast<unsigned char>(m_preloadCharacters[j]));
+        if (!m_preloadCancelled.load())
+            extractor.KerningPairs();
+    }
+
+    m_preloadedAll[slot] = !m_preloadCancelled.load();
+    m_preloaded[slot] = chrono::duration<double>(chrono::steady_clock::now() - m_preloadStart).count();
+    m_preloading.fetch_sub(1);
+}
+
+void FontLoader::Request(const string &filename, const string &text)
+{
+    m_preloadCancelled.store(true);
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_filename = filename;
+        m_text = text;
+        ++m_requested;
+        if (!m_worker.joinable() && !m_stopping)
+            m_worker = thread(&FontLoader::Work, this);
+    }
+    m_wake.notify_one();
+}
+
+bool FontLoader::Swap()
+{
+    // frames only take the lock when there is a load to swap in
+    if (!m_ready.load(memory_order_acquire))
+        return false;
+
+    bool current;
+    {
+        lock_guard<mutex> lock(m_mutex);
+
+        // a load finished just as a newer request came is dropped, and the
+        // worker starts again in the same slot
+        current = m_slots[1 - m_front].serial == m_requested;
+        if (current)
+            m_front = 1 - m_front;
+        m_ready.store(false, memory_order_relaxed);
+    }
+    m_wake.notify_one();
+    return current;
+}
+
+void FontLoader::Stop()
+{
+    m_preloadCancelled.store(true);
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    if (m_worker.joinable())
+        m_worker.join();
+    for (int i = 0; i < 2; ++i) {
+        if (m_preloaders[i].joinable())
+            m_preloaders[i].join();
+    }
+}
+
+void FontLoader::Work()
+{
+    Profiler::NameThread("font loader");
+
+    // the slots are the preloaders' until they finish, which the request
+    // that started the worker has asked them to do
+    for (int i = 0; i < 2; ++i) {
+        if (m_preloaders[i].joinable())
+            m_preloaders[i].join();
+    }
+
+    unique_lock<mutex> lock(m_mutex);
+    for (;;)
+    {
+        // wait for a request not yet started, and for the back slot to be
+        // free of a load that has not been swapped in
+        while (!m_stopping && (m_started == m_requested || m_ready.load(memory_order_relaxed)))
+            m_wake.wait(lock);
+        if (m_stopping)
+            return;
+
+        // the back slot is the worker's alone until it is marked ready
+        FontSlot &slot = m_slots[1 - m_front];
+        slot.filename = m_filename;
+        slot.text = m_text;
+        slot.serial = m_started = m_requested;
+        lock.unlock();
+
+        // opening the font and laying out the text decodes the outline of
+        // every glyph in it, which the extractor then holds, and reads the
+        // font's kerning pairs
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        slot.run = 0;
+        {
+            PROFILE_SCOPE("Load font");
+            if (slot.extractor.LoadFontFile(slot.filename)) {
+                slot.extractor.KerningPairs();
+                slot.run = &slot.layout.Layout(slot.text);
+            }
+        }
+        slot.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        if (slot.serial != m_requested)
+            continue;
+        m_ready.store(true, memory_order_release);
+        lock.unlock();
+
+        if (m_notify)
+            m_notify();
+        lock.lock();
+    }
+}
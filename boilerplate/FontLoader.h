@@ -0,0 +1,126 @@
+// ==========================================================================
+// Background font loading
+//
+// Opens fonts, lays out text in them and decodes the outlines of its glyphs
+// on a worker thread, so whoever draws never waits on reading or parsing a
+// font file. Loads are made into one of two slots, each with an extractor
+// and layout of its own: the front slot is the one in use, and the worker
+// only ever writes the back one. A finished load marks the back slot ready,
+// and the owner swaps it to the front between frames; until then the front
+// slot is left exactly as it was.
+//
+// Only the latest request matters. One made while another is loading is
+// taken up as soon as that load finishes, and the overtaken load is never
+// published.
+//
+// Fonts can also be preloaded into both slots ahead of any request, on a
+// thread per slot, so switching to them later costs next to nothing. A
+// request, or stopping, cuts a preload short, so neither waits for it.
+// ==========================================================================
+#ifndef FONTLOADER_H
+#define FONTLOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GlyphExtractor.h"
+#include "TextLayout.h"
+
+// A font loaded with some text laid out in it. Fonts stay open in the
+// slot's extractor, so loading one the slot has loaded before is quick.
+struct FontSlot
+{
+    GlyphExtractor      extractor;
+    TextLayout          layout;
+
+    std::string         filename;
+    std::string         text;
+    const GlyphRun     *run;        // the text laid out, or 0 if the font failed
+    double              seconds;    // time the worker spent on the load
+    unsigned long       serial;     // the request it answers
+
+    FontSlot() : layout(extractor), run(0), seconds(0.0), serial(0) {}
+
+private:
+    // runs refer to the slot's own fonts
+    FontSlot(const FontSlot &);
+    FontSlot &operator=(const FontSlot &);
+};
+
+class FontLoader
+{
+    FontSlot                m_slots[2];
+    int                     m_front;
+    std::atomic<bool>       m_ready;        // the back slot holds a finished load
+
+    // the latest request, and the worker waiting for it, all under the mutex
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::string             m_filename;
+    std::string             m_text;
+    unsigned long           m_requested;
+    unsigned long           m_started;
+    bool                    m_stopping;
+    std::thread             m_worker;
+
+    std::function<void()>   m_notify;
+
+    // preloading, a thread per slot, which requests wait for
+    std::thread             m_preloaders[2];
+    std::vector<std::string> m_preloadFonts;
+    std::string             m_preloadCharacters;
+    std::atomic<int>        m_preloading;   // slots still preloading
+    std::atomic<bool>       m_preloadCancelled; // asked to stop early
+    std::chrono::steady_clock::time_point m_preloadStart;
+    double                  m_preloaded[2]; // seconds each slot took
+    bool                    m_preloadedAll[2];  // and whether it got through every font
+
+    // the loader owns its threads
+    FontLoader(const FontLoader &);
+    FontLoader &operator=(const FontLoader &);
+
+    void Work();
+    void PreloadSlot(int slot);
+
+public:
+    FontLoader();
+    ~FontLoader();
+
+    // sets a function the worker calls when a load is ready, to wake an
+    // owner that sleeps until something happens
+    void SetNotify(const std::function<void()> &notify)    { m_notify = notify; }
+
+    // opens fonts in both slots and decodes the given characters in each,
+    // in the background, until the first request
+    void Preload(const std::vector<std::string> &filenames, const std::string &characters);
+
+    // true until a preload has finished, how long it took once it has, and
+    // whether a request or stopping cut it short
+    bool Preloading() const             { return m_preloading.load() > 0; }
+    double PreloadSeconds() const;
+    bool PreloadCancelled() const;
+
+    // asks for a font with some text laid out in it, replacing any request
+    // not yet published; the worker is started by the first request
+    void Request(const std::string &filename, const std::string &text);
+
+    // makes a finished load the front slot, returning true if there was one;
+    // the slot swapped out must no longer be used once this returns
+    bool Swap();
+
+    // the slot in use; only to be used from the thread that calls Swap
+    FontSlot &Front()                   { return m_slots[m_front]; }
+
+    // finishes any load or preload under way and stops the threads; called
+    // by the destructor, but better called before the end of the program
+    void Stop();
+};
+
+// --------------------------------------------------------------------------
+#endif // FONTLOADER_H
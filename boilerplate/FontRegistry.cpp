@@ -0,0 +1,108 @@
+// ==========================================================================
+// Font face registry
+// ==========================================================================
+
+#include "FontRegistry.h"
+#include <iostream>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+FontRegistry::FontRegistry()
+{
+    // initialize freetype library
+    FT_Error error = FT_Init_FreeType(&m_library);
+    if (error) {
+        cout << "ERROR: FreeType failed to initialize!" << endl;
+        m_library = 0;
+    }
+}
+
+FontRegistry::~FontRegistry()
+{
+    // faces must be released before the memory they were created over
+    for (size_t i = 0; i < m_fonts.size(); ++i) {
+        if (m_fonts[i].face) FT_Done_Face(m_fonts[i].face);
+        delete m_fonts[i].file;
+    }
+    if (m_library) FT_Done_FreeType(m_library);
+}
+
+// --------------------------------------------------------------------------
+
+FontHandle FontRegistry::Find(const string &filename) const
+{
+    for (size_t i = 0; i < m_fonts.size(); ++i) {
+        if (m_fonts[i].filename == filename)
+            return static_cast<FontHandle>(i);
+    }
+    return -1;
+}
+
+FontHandle FontRegistry::Open(const string &filename, bool openFace)
+{
+    // fonts are only ever parsed once
+    FontHandle existing = Find(filename);
+    if (existing >= 0) {
+        if (openFace && !Face(existing))
+            return -1;
+        return existing;
+    }
+
+    if (!m_library)
+        return -1;
+
+    Font font;
+    font.filename = filename;
+    font.file = new MappedFile;
+    font.face = 0;
+    if (!font.file->Open(filename) || (openFace && !OpenFace(font))) {
+        delete font.file;
+        return -1;
+    }
+
+    m_fonts.push_back(font);
+    return static_cast<FontHandle>(m_fonts.size() - 1);
+}
+
+FT_Face FontRegistry::Face(FontHandle font) const
+{
+    const Font &entry = m_fonts[font];
+    if (!entry.face)
+        OpenFace(entry);
+    return entry.face;
+}
+
+unsigned long long FontRegistry::Hash(FontHandle font) const
+{
+    const unsigned char *bytes = Data(font);
+    size_t size = Size(font);
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool FontRegistry::OpenFace(const Font &font) const
+{
+    FT_Error error = FT_New_Memory_Face(m_library, font.file->Data(),
+        static_cast<FT_Long>(font.file->Size()), 0, &font.face);
+
+    if (error == FT_Err_Unknown_File_Format) {
+        cout << "Freetype ERROR: unsupported file format in " << font.filename << endl;
+        font.face = 0;
+        return false;
+    }
+    else if (error) {
+        cout << "FreeType ERROR: unknown error occurred." << error << endl;
+        font.face = 0;
+        return false;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
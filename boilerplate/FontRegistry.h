@@ -0,0 +1,73 @@
+// ==========================================================================
+// Font face registry
+//
+// Keeps every font that has been opened alive for the life of the registry.
+// Each font file is memory-mapped once and its face created over the mapping
+// with FT_New_Memory_Face, so switching between fonts is a handle lookup
+// rather than a reparse from disk. Opening the same file again returns the
+// existing handle. Faces can also be created lazily, for fonts whose outlines
+// are normally served from somewhere else.
+// ==========================================================================
+#ifndef FONTREGISTRY_H
+#define FONTREGISTRY_H
+
+#include <string>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "MappedFile.h"
+
+// Handle to a font in the registry; negative values are invalid.
+typedef int FontHandle;
+
+class FontRegistry
+{
+    struct Font
+    {
+        std::string     filename;
+        MappedFile     *file;
+        mutable FT_Face face;
+    };
+
+    FT_Library          m_library;
+    std::vector<Font>   m_fonts;
+
+    // the registry owns its library and faces
+    FontRegistry(const FontRegistry &);
+    FontRegistry &operator=(const FontRegistry &);
+
+    // creates the FreeType face for a mapped font, returning true if successful
+    bool OpenFace(const Font &font) const;
+
+public:
+    FontRegistry();
+    ~FontRegistry();
+
+    // maps and opens the font file (once), returning its handle or -1 on error;
+    // without openFace the file is only mapped and the face is created on demand
+    FontHandle Open(const std::string &filename, bool openFace = true);
+
+    // returns the handle of an already opened file, or -1
+    FontHandle Find(const std::string &filename) const;
+
+    // number of open fonts; valid handles are 0 to Count()-1
+    int Count() const   { return static_cast<int>(m_fonts.size()); }
+
+    // the face for a font (0 if it cannot be opened); only to be used from the
+    // thread owning the registry
+    FT_Face Face(FontHandle font) const;
+
+    // the mapped font file, which may be shared freely between threads
+    const std::string &Filename(FontHandle font) const  { return m_fonts[font].filename; }
+    const unsigned char *Data(FontHandle font) const    { return m_fonts[font].file->Data(); }
+    size_t Size(FontHandle font) const                  { return m_fonts[font].file->Size(); }
+
+    // a 64-bit FNV-1a hash of the font file, identifying its contents for
+    // files built from it
+    unsigned long long Hash(FontHandle font) const;
+};
+
+// --------------------------------------------------------------------------
+#endif // FONTREGISTRY_H
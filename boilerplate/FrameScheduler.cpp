@@ -0,0 +1,64 @@
+// ==========================================================================
+// Frame scheduling
+// ==========================================================================
+
+#include "FrameScheduler.h"
+#include <algorithm>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+FrameScheduler::FrameScheduler(double stepSeconds, double maxLag)
+    : m_step(stepSeconds), m_maxLag(max(maxLag, stepSeconds)), m_lag(0.0),
+      m_last(Clock::now()), m_running(false), m_policy(VSYNC)
+{
+}
+
+void FrameScheduler::Start()
+{
+    if (m_running)
+        return;
+    m_last = Clock::now();
+    m_running = true;
+}
+
+int FrameScheduler::TakeSteps()
+{
+    if (!m_running)
+        return 0;
+
+    Clock::time_point now = Clock::now();
+    m_lag = min(m_lag + chrono::duration<double>(now - m_last).count(), m_maxLag);
+    m_last = now;
+
+    int steps = static_cast<int>(m_lag / m_step);
+    m_lag -= steps * m_step;
+    return steps;
+}
+
+double FrameScheduler::UntilNextStep() const
+{
+    double elapsed = chrono::duration<double>(Clock::now() - m_last).count();
+    return max(0.0, m_step - m_lag - elapsed);
+}
+
+int FrameScheduler::SwapInterval() const
+{
+    // a negative interval swaps late frames immediately instead of waiting
+    // for the next refresh
+    switch (m_policy) {
+    case VSYNC:             return 1;
+    case ADAPTIVE_VSYNC:    return -1;
+    default:                return 0;
+    }
+}
+
+const char *FrameScheduler::PolicyName(SwapPolicy policy)
+{
+    switch (policy) {
+    case VSYNC:             return "synchronized to the display";
+    case ADAPTIVE_VSYNC:    return "synchronized, tearing when late";
+    default:                return "not synchronized, paced by the animation step";
+    }
+}
@@ -0,0 +1,69 @@
+// ==========================================================================
+// Frame scheduling
+//
+// Decouples animation from frame rate. Animation advances in fixed steps of
+// simulated time: each frame runs however many whole steps have come due
+// since the last, and can draw a fraction of the way into the next, so
+// movement is the same speed at any frame rate and on any machine. When
+// nothing is animating, the owner should block waiting for input instead of
+// drawing; when something is, the scheduler says how long remains until the
+// next step, for owners that wait rather than synchronize to the display.
+//
+// The scheduler also holds the swap policy: synchronized to the display,
+// synchronized but tearing when a frame is late (where supported), or not
+// synchronized at all.
+// ==========================================================================
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <chrono>
+
+class FrameScheduler
+{
+public:
+    enum SwapPolicy { VSYNC, ADAPTIVE_VSYNC, IMMEDIATE, SWAP_POLICY_COUNT };
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    double              m_step;         // seconds of simulated time per step
+    double              m_maxLag;       // most time a frame catches up on
+    double              m_lag;          // time due but not yet stepped
+    Clock::time_point   m_last;
+    bool                m_running;
+    SwapPolicy          m_policy;
+
+public:
+    explicit FrameScheduler(double stepSeconds = 1.0 / 60.0, double maxLag = 0.25);
+
+    // starts stepping from now, or stops; time that passes while stopped is
+    // never stepped, so animation resumes where it left off
+    void Start();
+    void Stop()                     { m_running = false; }
+    bool Running() const            { return m_running; }
+
+    // the number of whole steps due since the last call, which the caller
+    // should run; after a stall, no more than the maximum lag is caught up
+    int TakeSteps();
+
+    // how far the present is into the next step, in [0, 1), and the seconds
+    // left until it is due
+    double Fraction() const         { return m_lag / m_step; }
+    double UntilNextStep() const;
+
+    double StepSeconds() const      { return m_step; }
+
+    // the swap policy, and the interval to give the swap control for it
+    SwapPolicy Policy() const       { return m_policy; }
+    void SetPolicy(SwapPolicy policy) { m_policy = policy; }
+    int SwapInterval() const;
+
+    // true if frames are paced by waiting on the clock rather than on the
+    // display, as they are when not synchronized
+    bool WaitsForSteps() const      { return m_policy == IMMEDIATE; }
+
+    static const char *PolicyName(SwapPolicy policy);
+};
+
+// --------------------------------------------------------------------------
+#endif // FRAMESCHEDULER_H
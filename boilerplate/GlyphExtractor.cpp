@@ -17,7 +17,14 @@
 // ==========================================================================
 
 #include "GlyphExtractor.h"
+#include "OutlinePack.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 // set this true to print information about the font loaded and glyphs extracted
 #define DEBUG_PRINT 0
@@ -27,35 +34,88 @@ using namespace std;
 // --------------------------------------------------------------------------
 
 GlyphExtractor::GlyphExtractor()
-    : m_face(0)
+    : m_font(-1), m_face(0), m_cacheHits(0), m_cacheMisses(0),
+      m_pack(0), m_usePacks(true)
 {
-    // initialize freetype library
-    FT_Error error = FT_Init_FreeType(&m_library);
-    if (error) {
-        cout << "ERROR: FreeType failed to initialize!" << endl;
-    }
+    static atomic<unsigned long> extractors(0);
+    m_serial = ++extractors;
+}
+
+GlyphExtractor::~GlyphExtractor()
+{
+    for (size_t i = 0; i < m_packs.size(); ++i)
+        delete m_packs[i];
 }
 
 // --------------------------------------------------------------------------
 
+// opens the outline pack for a mapped font, if there is an up-to-date one
+static OutlinePack *OpenOutlinePack(const FontRegistry &registry, FontHandle font)
+{
+    string packname = OutlinePackFilename(registry.Filename(font));
+    if (!ifstream(packname.c_str()))
+        return 0;
+
+    // packs are matched to their font by a hash of its contents
+    OutlinePack *pack = new OutlinePack;
+    if (!pack->Open(packname, registry.Hash(font))) {
+        delete pack;
+        return 0;
+    }
+    return pack;
+}
+
 bool GlyphExtractor::LoadFontFile(const string &filename)
 {
-    FT_Error error = FT_New_Face(m_library, filename.c_str(), 0, &m_face);
+    FontHandle font = m_registry.Find(filename);
+    if (font < 0)
+    {
+        // the registry maps and parses each file only the first time; fonts
+        // with an outline pack only get a face if one is ever asked for
+        font = m_registry.Open(filename, false);
+        if (font < 0)
+            return false;
+        OutlinePack *pack = m_usePacks ? OpenOutlinePack(m_registry, font) : 0;
+        if (!pack && !m_registry.Face(font))
+            return false;
+
+        m_packs.resize(m_registry.Count(), 0);
+        m_packs[font] = pack;
+    }
 
-    if (error == FT_Err_Unknown_File_Format) {
-        cout << "Freetype ERROR: unsupported file format in " << filename << endl;
+    return SelectFont(font);
+}
+
+bool GlyphExtractor::SelectFont(FontHandle font)
+{
+    if (font < 0 || font >= m_registry.Count())
         return false;
+
+    if (m_caches.size() < static_cast<size_t>(m_registry.Count())) {
+        m_caches.resize(m_registry.Count());
+        m_packs.resize(m_registry.Count(), 0);
     }
-    else if (error) {
-        cout << "FreeType ERROR: unknown error occurred." << error << endl;
+
+    // only fonts without a pack need their FreeType face
+    const OutlinePack *pack = m_usePacks ? m_packs[font] : 0;
+    FT_Face face = pack ? 0 : m_registry.Face(font);
+    if (!pack && !face)
         return false;
-    }
 
-    if (DEBUG_PRINT) PrintFontInformation();
+    m_font = font;
+    m_pack = pack;
+    m_face = face;
+
+    if (DEBUG_PRINT && m_face) PrintFontInformation();
 
     return true;
 }
 
+void GlyphExtractor::ClearCache()
+{
+    if (m_font >= 0) m_caches[m_font].clear();
+}
+
 // --------------------------------------------------------------------------
 
 void GlyphExtractor::PrintFontInformation() const
@@ -66,65 +126,270 @@ void GlyphExtractor::PrintFontInformation() const
     cout << "  Units per EM: \t" << m_face->units_per_EM << endl;
 }
 
-void GlyphExtractor::PrintGlyphInformation(int character) const
+void GlyphExtractor::PrintGlyphInformation(FT_Face face, int character, ostream &out)
 {
-    FT_Outline &outline = m_face->glyph->outline;
+    FT_Outline &outline = face->glyph->outline;
 
-    cout << "Glyph information for character "
-         << character << " (" << char(character) << "):" <<  endl;
-    cout << "  Advance: " << m_face->glyph->advance.x
-         << ", " << m_face->glyph->advance.y << endl;
-    cout << "  Number of contours: " << outline.n_contours << endl;
-    cout << "  Number of points:   " << outline.n_points << endl;
+    out << "Glyph information for character "
+        << character << " (" << char(character) << "):" <<  endl;
+    out << "  Advance: " << face->glyph->advance.x
+        << ", " << face->glyph->advance.y << endl;
+    out << "  Number of contours: " << outline.n_contours << endl;
+    out << "  Number of points:   " << outline.n_points << endl;
 
-    cout << "  Points:";
+    out << "  Points:";
     for (int i = 0; i < outline.n_points; ++i)
     {
         FT_Vector v = outline.points[i];
-        cout << " (" << v.x << "," << v.y << ")";
-        if (outline.tags[i] & 1) cout << "+";
-        else cout << "-" << ((outline.tags[i] & 2) ? '3' : '2');
+        out << " (" << v.x << "," << v.y << ")";
+        if (outline.tags[i] & 1) out << "+";
+        else out << "-" << ((outline.tags[i] & 2) ? '3' : '2');
     }
-    cout << endl;
+    out << endl;
 }
 
 // --------------------------------------------------------------------------
 
 MyGlyph GlyphExtractor::ExtractGlyph(int character) const
+{
+    return ExtractPackedGlyph(character).Unpack();
+}
+
+MyPackedGlyph GlyphExtractor::ExtractPackedGlyph(int character) const
 {
     // first check that a font has been loaded
-    if (!m_face) {
+    if (m_font < 0) {
         cout << "GlyphExtractor ERROR: No font loaded!" << endl;
-        return MyGlyph();
+        return MyPackedGlyph();
     }
 
-    // look up the glyph index for the given character code
-    int index = FT_Get_Char_Index(m_face, character);
+    // glyphs in an outline pack are served straight from the mapping
+    if (m_pack) {
+        MyPackedGlyph glyph;
+        if (m_pack->Find(character, glyph)) {
+            ++m_cacheHits;
+        }
+        else {
+            ++m_cacheMisses;
+            cout << "FreeType ERROR: Could not find glyph outline for character "
+                 << character << " (" << char(character) << ")" <<  endl;
+        }
+        return glyph;
+    }
 
-    // load the glyph for the given character into the face glyph slot,
-    // keeping the outline in original font units
-    FT_Error error = FT_Load_Glyph(m_face, index, FT_LOAD_NO_SCALE);
-    if (error || m_face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+    // serve the outline from the cache if this character was seen before
+    GlyphCache &cache = m_caches[m_font];
+    GlyphCache::const_iterator it = cache.find(character);
+    if (it != cache.end()) {
+        ++m_cacheHits;
+        return it->second.View();
+    }
+
+    // otherwise decode it once; failed lookups are cached too so that a missing
+    // character does not send us back to FreeType on every call
+    ++m_cacheMisses;
+    MyPackedGlyphStorage &glyph = cache[character];
+    DecodeGlyph(m_face, character, glyph, cout);
+    return glyph.View();
+}
+
+// --------------------------------------------------------------------------
+
+vector<MyPackedGlyphStorage> GlyphExtractor::ExtractGlyphs(const vector<int> &characters,
+                                                          unsigned int threads) const
+{
+    vector<MyPackedGlyphStorage> glyphs(characters.size());
+    if (m_font < 0) {
+        cout << "GlyphExtractor ERROR: No font loaded!" << endl;
+        return glyphs;
+    }
+
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+
+    // FreeType faces cannot be shared between threads, so every worker opens
+    // its own library and face over the same memory-mapped font file
+    const unsigned char *data = m_registry.Data(m_font);
+    FT_Long size = static_cast<FT_Long>(m_registry.Size(m_font));
+
+    // workers claim small chunks of characters, which keeps them balanced
+    // even though glyph complexity varies a lot
+    const size_t chunk = 32;
+    atomic<size_t> next(0);
+
+    // each worker keeps its messages until all are done, so that output from
+    // different threads is not interleaved; a worker that cannot open the
+    // font leaves its share to the others
+    vector<string> logs(threads);
+    atomic<unsigned int> failed(0);
+
+    auto worker = [&](unsigned int id) {
+        ostringstream log;
+        FT_Library library;
+        FT_Face face;
+        if (FT_Init_FreeType(&library)) {
+            log << "FreeType ERROR: Could not initialize FreeType in worker " << id << endl;
+            logs[id] = log.str();
+            ++failed;
+            return;
+        }
+        if (FT_New_Memory_Face(library, data, size, 0, &face)) {
+            log << "FreeType ERROR: Could not open the font in worker " << id << endl;
+            logs[id] = log.str();
+            ++failed;
+            FT_Done_FreeType(library);
+            return;
+        }
+
+        for (size_t begin = next.fetch_add(chunk); begin < characters.size();
+             begin = next.fetch_add(chunk))
+        {
+            size_t end = min(begin + chunk, characters.size());
+            for (size_t i = begin; i < end; ++i)
+                DecodeGlyph(face, characters[i], glyphs[i], log);
+        }
+
+        FT_Done_Face(face);
+        FT_Done_FreeType(library);
+        logs[id] = log.str();
+    };
+
+    // the calling thread works alongside the others
+    vector<thread> pool;
+    for (unsigned int i = 1; i < threads; ++i)
+        pool.push_back(thread(worker, i));
+    worker(0);
+    for (size_t i = 0; i < pool.size(); ++i)
+        pool[i].join();
+
+    for (size_t i = 0; i < logs.size(); ++i)
+        cout << logs[i];
+    if (failed == threads) {
+        cout << "GlyphExtractor ERROR: No worker could open the font, "
+             << "so no glyphs were extracted!" << endl;
+        glyphs.clear();
+    }
+
+    return glyphs;
+}
+
+const KerningTable &GlyphExtractor::KerningPairs() const
+{
+    static const KerningTable none;
+    if (m_font < 0)
+        return none;
+
+    if (m_kerning.size() < static_cast<size_t>(m_registry.Count())) {
+        m_kerning.resize(m_registry.Count());
+        m_kerningLoaded.resize(m_registry.Count(), false);
+    }
+
+    // packs carry the pairs with them; otherwise they are worked out from
+    // the font's tables once
+    if (!m_kerningLoaded[m_font]) {
+        if (m_pack)
+            m_pack->ReadKerning(m_kerning[m_font]);
+        else
+            m_kerning[m_font].Build(m_face, CharacterCodes());
+        m_kerningLoaded[m_font] = true;
+    }
+    return m_kerning[m_font];
+}
+
+vector<int> GlyphExtractor::CharacterCodes() const
+{
+    if (m_pack) return m_pack->CharacterCodes();
+
+    vector<int> characters;
+    if (!m_face) return characters;
+
+    FT_UInt index;
+    FT_ULong character = FT_Get_First_Char(m_face, &index);
+    while (index != 0) {
+        characters.push_back(static_cast<int>(character));
+        character = FT_Get_Next_Char(m_face, character, &index);
+    }
+
+    return characters;
+}
+
+// --------------------------------------------------------------------------
+// Outline conversion. The walk over a FreeType outline reports each contour
+// and segment to a sink, so packing can count everything first and then fill
+// a single allocation of exactly the right size.
+
+namespace {
+
+// counts the contours, segments and points a packed glyph will need
+struct OutlineCounter
+{
+    unsigned int contours, segments, points;
+
+    OutlineCounter() : contours(0), segments(0), points(0)
+    {}
+
+    // each contour stores its starting point once
+    void BeginContour()                     { ++contours; ++points; }
+    void AddSegment(const MySegment &seg)   { ++segments; points += seg.degree; }
+};
+
+// writes segments into packed glyph storage sized from an OutlineCounter
+struct OutlineWriter
+{
+    float           *points;
+    unsigned int    *segments;
+    unsigned int    *contours;
+    unsigned char   *degrees;
+    unsigned int     contour, segment, point;
+    bool             starting;
+
+    OutlineWriter(MyPackedGlyphStorage &glyph)
+        : points(glyph.Points()), segments(glyph.Segments()),
+          contours(glyph.Contours()), degrees(glyph.Degrees()),
+          contour(0), segment(0), point(0), starting(false)
+    {}
+
+    void BeginContour()
     {
-        cout << "FreeType ERROR: Could not find glyph outline for character "
-             << character << " (" << char(character) << ")" <<  endl;
-        return MyGlyph();
+        contours[contour++] = segment;
+        starting = true;
     }
 
-    if (DEBUG_PRINT) PrintGlyphInformation(character);
+    void AddSegment(const MySegment &seg)
+    {
+        // the first segment writes its start point, later ones share the
+        // previous segment's end point
+        if (starting) {
+            points[2*point] = seg.x[0];
+            points[2*point+1] = seg.y[0];
+            ++point;
+            starting = false;
+        }
 
-    // create a new glyph structure to populate with this character outline
-    FT_Outline &outline = m_face->glyph->outline;
-    float em = m_face->units_per_EM;
-    MyGlyph glyph(m_face->glyph->advance.x / em);
+        segments[segment] = point - 1;
+        degrees[segment] = static_cast<unsigned char>(seg.degree);
+        ++segment;
 
+        for (unsigned int i = 1; i <= seg.degree; ++i) {
+            points[2*point] = seg.x[i];
+            points[2*point+1] = seg.y[i];
+            ++point;
+        }
+    }
+
+    // closes the contour table with the total segment count
+    void Finish()   { contours[contour] = segment; }
+};
+
+template <class Sink>
+void ConvertOutline(const FT_Outline &outline, float em, Sink &sink)
+{
     // current point index
     int begin = 0;
 
     // iterate through the outline's contours
     for (int c = 0; c < outline.n_contours; ++c)
     {
-        MyContour contour;
+        sink.BeginContour();
 
         // iterate through current contour's points
         int end = outline.contours[c];
@@ -146,8 +411,10 @@ MyGlyph GlyphExtractor::ExtractGlyph(int character) const
                 segment.y[0] = r_p.y / em;
             }
             else {
-                segment.x[0] = 0.5f * (r_p.x + r_q.x) / em;
-                segment.y[0] = 0.5f * (r_p.y + r_q.y) / em;
+                // the midpoint the previous segment ends on, computed the
+                // same way so the two agree exactly
+                segment.x[0] = 0.5f * (r_p.x / em + r_q.x / em);
+                segment.y[0] = 0.5f * (r_p.y / em + r_q.y / em);
             }
 
             // set degree of segment based on what the next point is
@@ -196,14 +463,227 @@ MyGlyph GlyphExtractor::ExtractGlyph(int character) const
             }
 
             // add segment to contour
-            contour.push_back(segment);
+            sink.AddSegment(segment);
         }
 
         // set beginning of next contour
         begin = end + 1;
+    }
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+void GlyphExtractor::DecodeGlyph(FT_Face face, int character, MyPackedGlyphStorage &glyph,
+                                 ostream &log)
+{
+    // look up the glyph index for the given character code
+    int index = FT_Get_Char_Index(face, character);
+
+    // load the glyph for the given character into the face glyph slot,
+    // keeping the outline in original font units
+    FT_Error error = FT_Load_Glyph(face, index, FT_LOAD_NO_SCALE);
+    if (error || face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+    {
+        log << "FreeType ERROR: Could not find glyph outline for character "
+            << character << " (" << char(character) << ")" <<  endl;
+        glyph.Allocate(0, 0, 0, 0);
+        return;
+    }
+
+    if (DEBUG_PRINT) PrintGlyphInformation(face, character, log);
+
+    // size the packed glyph for this character outline, then populate it
+    FT_Outline &outline = face->glyph->outline;
+    float em = face->units_per_EM;
+
+    OutlineCounter counter;
+    ConvertOutline(outline, em, counter);
+    glyph.Allocate(face->glyph->advance.x / em,
+                   counter.contours, counter.segments, counter.points);
+
+    OutlineWriter writer(glyph);
+    ConvertOutline(outline, em, writer);
+    writer.Finish();
+    glyph.ComputeBounds();
+}
+
+// --------------------------------------------------------------------------
+// Packed glyph storage
+
+MyPackedGlyphStorage::MyPackedGlyphStorage()
+    : m_advance(0), m_contourCount(0), m_segmentCount(0), m_pointCount(0)
+{
+    m_bounds[0] = m_bounds[1] = m_bounds[2] = m_bounds[3] = 0;
+}
+
+size_t MyPackedGlyphStorage::Bytes(unsigned int contours, unsigned int segments,
+                                   unsigned int points)
+{
+    // points, segments and contours are all 4-byte values, so the degree
+    // bytes can go last without any padding
+    return sizeof(float) * 2 * points +
+           sizeof(unsigned int) * (segments + contours + 1) +
+           segments;
+}
+
+void MyPackedGlyphStorage::Allocate(float advance, unsigned int contours,
+                                    unsigned int segments, unsigned int points)
+{
+    m_advance = advance;
+    m_contourCount = contours;
+    m_segmentCount = segments;
+    m_pointCount = points;
+    m_bounds[0] = m_bounds[1] = m_bounds[2] = m_bounds[3] = 0;
+
+    m_data.assign(Bytes(contours, segments, points), 0);
+}
+
+// parameters in (0, 1) where one coordinate of a Bezier segment turns back,
+// from the roots of its derivative; returns how many were found
+static int SegmentExtrema(const float *p, unsigned int degree, float t[2])
+{
+    int count = 0;
+    if (degree == 2)
+    {
+        float denominator = p[0] - 2*p[2] + p[4];
+        if (denominator != 0.0f) {
+            float root = (p[0] - p[2]) / denominator;
+            if (root > 0.0f && root < 1.0f) t[count++] = root;
+        }
+    }
+    else if (degree == 3)
+    {
+        // the derivative over 3 is a t^2 + b t + c
+        float a = -p[0] + 3*p[2] - 3*p[4] + p[6];
+        float b = 2 * (p[0] - 2*p[2] + p[4]);
+        float c = p[2] - p[0];
+        float roots[2];
+        int found = 0;
+        if (fabs(a) < 1e-12f) {
+            if (b != 0.0f) roots[found++] = -c / b;
+        }
+        else {
+            float discriminant = b*b - 4*a*c;
+            if (discriminant >= 0.0f) {
+                float root = sqrt(discriminant);
+                roots[found++] = (-b + root) / (2*a);
+                roots[found++] = (-b - root) / (2*a);
+            }
+        }
+        for (int i = 0; i < found; ++i)
+            if (roots[i] > 0.0f && roots[i] < 1.0f) t[count++] = roots[i];
+    }
+    return count;
+}
+
+// one coordinate of a Bezier segment at parameter t
+static float EvaluateSegment(const float *p, unsigned int degree, float t)
+{
+    float s = 1.0f - t;
+    if (degree == 2)
+        return s*s*p[0] + 2*s*t*p[2] + t*t*p[4];
+    return s*s*s*p[0] + 3*s*s*t*p[2] + 3*s*t*t*p[4] + t*t*t*p[6];
+}
+
+void MyPackedGlyphStorage::ComputeBounds()
+{
+    const float *points = Points();
+    const unsigned int *segments = Segments();
+    const unsigned char *degrees = Degrees();
+    bool empty = true;
+    float box[4] = { 0, 0, 0, 0 };
+
+    // the outline passes through the ends of every segment, and reaches
+    // furthest between them only where a coordinate turns back; control
+    // points off the curve do not count, so the box is tight
+    for (unsigned int s = 0; s < m_segmentCount; ++s)
+    {
+        const float *p = points + 2 * segments[s];
+        unsigned int degree = degrees[s];
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            float values[4] = { p[axis], p[2*degree + axis] };
+            int count = 2;
+            float t[2];
+            int extrema = SegmentExtrema(p + axis, degree, t);
+            for (int i = 0; i < extrema; ++i)
+                values[count++] = EvaluateSegment(p + axis, degree, t[i]);
+
+            for (int i = 0; i < count; ++i) {
+                if (empty || values[i] < box[axis]) box[axis] = values[i];
+                if (empty || values[i] > box[axis + 2]) box[axis + 2] = values[i];
+            }
+        }
+        empty = false;
+    }
+
+    for (int i = 0; i < 4; ++i)
+        m_bounds[i] = box[i];
+}
 
-        // add contour to glyph
-        glyph.contours.push_back(contour);
+float *MyPackedGlyphStorage::Points()
+{
+    return reinterpret_cast<float *>(m_data.data());
+}
+
+unsigned int *MyPackedGlyphStorage::Segments()
+{
+    return reinterpret_cast<unsigned int *>(Points() + 2 * m_pointCount);
+}
+
+unsigned int *MyPackedGlyphStorage::Contours()
+{
+    return Segments() + m_segmentCount;
+}
+
+unsigned char *MyPackedGlyphStorage::Degrees()
+{
+    return reinterpret_cast<unsigned char *>(Contours() + m_contourCount + 1);
+}
+
+MyPackedGlyph MyPackedGlyphStorage::View() const
+{
+    MyPackedGlyph glyph;
+    glyph.advance = m_advance;
+    for (int i = 0; i < 4; ++i)
+        glyph.bounds[i] = m_bounds[i];
+    if (m_data.empty())
+        return glyph;
+
+    glyph.contourCount = m_contourCount;
+    glyph.segmentCount = m_segmentCount;
+    glyph.pointCount = m_pointCount;
+    glyph.points = reinterpret_cast<const float *>(m_data.data());
+    glyph.segments = reinterpret_cast<const unsigned int *>(glyph.points + 2 * m_pointCount);
+    glyph.contours = glyph.segments + m_segmentCount;
+    glyph.degrees = reinterpret_cast<const unsigned char *>(glyph.contours + m_contourCount + 1);
+    return glyph;
+}
+
+MyGlyph MyPackedGlyph::Unpack() const
+{
+    MyGlyph glyph(advance);
+    for (int i = 0; i < 4; ++i)
+        glyph.bounds[i] = bounds[i];
+    glyph.contours.resize(contourCount);
+
+    for (unsigned int c = 0; c < contourCount; ++c)
+    {
+        MyContour &contour = glyph.contours[c];
+        contour.reserve(contours[c+1] - contours[c]);
+
+        for (unsigned int s = contours[c]; s < contours[c+1]; ++s)
+        {
+            MySegment segment(degrees[s]);
+            const float *p = points + 2 * segments[s];
+            for (unsigned int i = 0; i <= segment.degree; ++i) {
+                segment.x[i] = p[2*i];
+                segment.y[i] = p[2*i+1];
+            }
+            contour.push_back(segment);
+        }
     }
 
     return glyph;
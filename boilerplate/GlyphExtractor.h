@@ -9,6 +9,9 @@
 //  - A contour consists of one or more segments (stored as std::vector)
 //  - A segment is either a straight line, quadratic Bezier, or cubic Bezier
 //
+// Glyphs are also available in a packed form (MyPackedGlyph), which holds the
+// same outline in a single flat allocation and is what the extractor caches.
+//
 // You may use this code (or not) however you see fit for your work.
 //
 // Author:  Sonny Chan
@@ -18,12 +21,17 @@
 #ifndef GLYPHEXTRACTOR_H
 #define GLYPHEXTRACTOR_H
 
+#include <ostream>
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include "FontRegistry.h"
+#include "KerningTable.h"
+
 // --------------------------------------------------------------------------
 // DATA STRUCTURES: Segment, Contour, and Glyph
 
@@ -50,34 +58,187 @@ struct MyGlyph
     // advance width to next glyph, in EM units
     float advance;
 
+    // tight bounding box of the contours (xmin, ymin, xmax, ymax), in EM units
+    float bounds[4];
+
     // contours that form this glyph, in EM-box coordinates
     std::vector<MyContour> contours;
 
     MyGlyph(float adv = 0) : advance(adv)
-    {}
+    {
+        bounds[0] = bounds[1] = bounds[2] = bounds[3] = 0;
+    }
+};
+
+// --------------------------------------------------------------------------
+// PACKED GLYPHS: the same outline as MyGlyph, stored as flat arrays.
+//  - points holds x,y pairs; consecutive segments of a contour share their
+//    common endpoint, so a segment of degree d uses points [first, first+d]
+//  - segments holds the index of each segment's first point, and degrees
+//    holds each segment's degree
+//  - contours holds the index of each contour's first segment, followed by
+//    the total segment count, so contour c spans [contours[c], contours[c+1])
+
+// A read-only view of a packed glyph; the data belongs to whoever produced it.
+struct MyPackedGlyph
+{
+    // advance width to next glyph, in EM units
+    float advance;
+
+    // tight bounding box of the outline (xmin, ymin, xmax, ymax), in EM units
+    float bounds[4];
+
+    unsigned int contourCount;
+    unsigned int segmentCount;
+    unsigned int pointCount;
+
+    const float         *points;
+    const unsigned int  *segments;
+    const unsigned char *degrees;
+    const unsigned int  *contours;
+
+    MyPackedGlyph() : advance(0), contourCount(0), segmentCount(0), pointCount(0),
+        points(0), segments(0), degrees(0), contours(0)
+    {
+        bounds[0] = bounds[1] = bounds[2] = bounds[3] = 0;
+    }
+
+    // expands the glyph into the nested MyGlyph representation
+    MyGlyph Unpack() const;
+};
+
+// Owns the data of a packed glyph in a single allocation.
+class MyPackedGlyphStorage
+{
+    float                       m_advance;
+    float                       m_bounds[4];
+    unsigned int                m_contourCount;
+    unsigned int                m_segmentCount;
+    unsigned int                m_pointCount;
+    std::vector<unsigned char>  m_data;
+
+public:
+    MyPackedGlyphStorage();
+
+    // sizes the storage for the given counts, discarding previous contents
+    void Allocate(float advance, unsigned int contours, unsigned int segments,
+                  unsigned int points);
+
+    // writable arrays, laid out as points, segments, contours then degrees
+    float *Points();
+    unsigned int *Segments();
+    unsigned int *Contours();
+    unsigned char *Degrees();
+
+    // recomputes the bounding box from the curves once the outline has been
+    // written, including where they bulge out between their ends
+    void ComputeBounds();
+
+    // size in bytes of the packed arrays for the given counts
+    static size_t Bytes(unsigned int contours, unsigned int segments, unsigned int points);
+
+    // a view of the stored glyph, valid until the storage is changed
+    MyPackedGlyph View() const;
 };
 
 // --------------------------------------------------------------------------
 // This class encapsulates functionality required to load a font file from
-// disk and retrieve glyph outlines for characters from the font.
+// disk and retrieve glyph outlines for characters from the font. Every font
+// loaded stays open in the registry, so loading it again is instant. Fonts
+// with a precompiled outline pack next to them are served from the pack and
+// never go through FreeType.
+
+class OutlinePack;
 
 class GlyphExtractor
 {
-    FT_Library  m_library;
-    FT_Face     m_face;
+    typedef std::unordered_map<int, MyPackedGlyphStorage> GlyphCache;
+
+    FontRegistry    m_registry;
+    FontHandle      m_font;
+    FT_Face         m_face;
+    unsigned long   m_serial;
+
+    // outlines already extracted from each face, keyed by character
+    mutable std::vector<GlyphCache> m_caches;
+    mutable unsigned long m_cacheHits;
+    mutable unsigned long m_cacheMisses;
+
+    // outline packs by font handle (0 where a font has none), and the current one
+    std::vector<OutlinePack *> m_packs;
+    const OutlinePack *m_pack;
+    bool m_usePacks;
+
+    // kerning pairs by font handle, read from the pack or font when first used
+    mutable std::vector<KerningTable> m_kerning;
+    mutable std::vector<bool> m_kerningLoaded;
+
+    // the extractor owns its packs
+    GlyphExtractor(const GlyphExtractor &);
+    GlyphExtractor &operator=(const GlyphExtractor &);
 
     // private methods to print font/glyph info, for debugging
     void PrintFontInformation() const;
-    void PrintGlyphInformation(int character) const;
+    static void PrintGlyphInformation(FT_Face face, int character, std::ostream &out);
+
+    // decodes the outline for a character from the given face (uncached),
+    // writing any errors to log
+    static void DecodeGlyph(FT_Face face, int character, MyPackedGlyphStorage &glyph,
+                            std::ostream &log);
 
 public:
     GlyphExtractor();
+    ~GlyphExtractor();
 
-    // call this method first to load a font file
+    // call this method first to load a font file (or switch to one loaded before)
     bool LoadFontFile(const std::string &filename);
 
+    // switches to a font already in the registry
+    bool SelectFont(FontHandle font);
+
+    // sets whether fonts are served from their outline packs when available
+    // (on by default); turned off to build packs from the fonts themselves
+    void UseOutlinePacks(bool use)  { m_usePacks = use; }
+
     // this method retrieves a (possibly composite) glyph for the given character
     MyGlyph ExtractGlyph(int character) const;
+
+    // retrieves the packed glyph for the given character; the view stays valid
+    // until the cache of the current font is cleared
+    MyPackedGlyph ExtractPackedGlyph(int character) const;
+
+    // retrieves glyphs for many characters at once from the current font,
+    // spreading the work over the given number of threads (0 = one per core);
+    // results are returned in the same order as the characters, or empty if
+    // no thread could open the font
+    std::vector<MyPackedGlyphStorage> ExtractGlyphs(const std::vector<int> &characters,
+                                                    unsigned int threads = 0) const;
+
+    // lists every character code the current font has a glyph for
+    std::vector<int> CharacterCodes() const;
+
+    // the adjustment to the advance of the left character when followed by
+    // the right one in the current font, in EM units
+    float Kerning(int left, int right) const    { return KerningPairs().Find(left, right); }
+
+    // every kerning pair of the current font
+    const KerningTable &KerningPairs() const;
+
+    // discards the cached outlines of the current font
+    void ClearCache();
+
+    // the current font and the registry holding every font loaded so far
+    FontHandle CurrentFont() const              { return m_font; }
+    const FontRegistry &Registry() const        { return m_registry; }
+
+    // identifies the extractor for the life of the program, as its address
+    // may be reused by another once it is gone
+    unsigned long Serial() const                { return m_serial; }
+
+    // number of glyph lookups served without FreeType (from the cache or an
+    // outline pack), or decoded by FreeType
+    unsigned long CacheHits() const     { return m_cacheHits; }
+    unsigned long CacheMisses() const   { return m_cacheMisses; }
 };
 
 // --------------------------------------------------------------------------
@@ -0,0 +1,251 @@
+// ==========================================================================
+// Software rasterizer for filled glyphs
+// ==========================================================================
+
+#include "GlyphRasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// a quarter pixel is below what anti-aliasing can show
+const float GlyphRasterizer::TOLERANCE = 0.25f;
+
+// --------------------------------------------------------------------------
+
+GlyphRasterizer::GlyphRasterizer()
+    : m_width(0), m_height(0), m_stride(0)
+{
+}
+
+void GlyphRasterizer::Resize(int width, int height)
+{
+    m_width = max(0, width);
+    m_height = max(0, height);
+
+    // a line ending on the right edge spills into the next two cells
+    m_stride = (m_width + 2 + 3) & ~3;
+    m_accumulation.assign(size_t(m_stride) * m_height, 0.0f);
+    Clear();
+}
+
+void GlyphRasterizer::AddGlyph(const MyPackedGlyph &glyph, float x, float y, float size)
+{
+    m_flattener.AddGlyph(glyph, x, y, size);
+}
+
+void GlyphRasterizer::AddLines(const float *lines, size_t count)
+{
+    // flip to rows counted from the top
+    for (size_t i = 0; i < 2 * count; ++i, lines += 2) {
+        m_lines.push_back(lines[0]);
+        m_lines.push_back(float(m_height) - lines[1]);
+    }
+}
+
+void GlyphRasterizer::FlushOutlines()
+{
+    // this also picks up straight segments queued with glyphs
+    vector<float> lines;
+    m_flattener.Flatten(TOLERANCE, lines);
+    AddLines(lines.data(), lines.size() / 4);
+}
+
+void GlyphRasterizer::Clear()
+{
+    m_flattener.Clear();
+    m_lines.clear();
+}
+
+// --------------------------------------------------------------------------
+// Accumulation
+
+// adds the signed area a line covers to every cell of the rows it crosses
+// within [firstRow, lastRow); the area to the right of the line within a
+// row adds up to its height there, so a running sum along the row yields
+// how many times (and how much) each pixel is wound
+static void AccumulateLine(float *accumulation, int stride, int width, int firstRow, int lastRow,
+                           float x0, float y0, float x1, float y1)
+{
+    if (y0 == y1)
+        return;
+
+    // always walk downwards, remembering the winding direction
+    float direction = 1.0f;
+    if (y0 > y1) {
+        swap(x0, x1);
+        swap(y0, y1);
+        direction = -1.0f;
+    }
+    if (y1 <= firstRow || y0 >= lastRow)
+        return;
+
+    float dxdy = (x1 - x0) / (y1 - y0);
+    int rowStart = max(firstRow, int(floor(y0)));
+    int rowEnd = min(lastRow, int(ceil(y1)));
+    float right = float(width);
+
+    for (int y = rowStart; y < rowEnd; ++y)
+    {
+        float top = max(float(y), y0);
+        float bottom = min(float(y + 1), y1);
+        float dy = bottom - top;
+        if (dy <= 0.0f)
+            continue;
+
+        // where the line enters and leaves this row; anything beyond the
+        // sides is pushed onto them, which keeps each row's total intact
+        float xa = min(max(x0 + (top - y0) * dxdy, 0.0f), right);
+        float xb = min(max(x0 + (bottom - y0) * dxdy, 0.0f), right);
+        float d = dy * direction;
+        float *row = accumulation + size_t(y - firstRow) * stride;
+
+        float xl = min(xa, xb), xr = max(xa, xb);
+        int il = int(xl);
+        int ir = int(ceil(xr));
+
+        if (ir <= il + 1)
+        {
+            // within a single pixel: split by the line's mean position
+            float xm = 0.5f * (xa + xb) - il;
+            row[il] += d - d * xm;
+            row[il + 1] += d * xm;
+        }
+        else
+        {
+            // across several pixels: triangles at the ends, a ramp between
+            float s = 1.0f / (xr - xl);
+            float fl = xl - il;
+            float a0 = 0.5f * s * (1.0f - fl) * (1.0f - fl);
+            float fr = xr - ir + 1.0f;
+            float am = 0.5f * s * fr * fr;
+
+            row[il] += d * a0;
+            if (ir == il + 2) {
+                row[il + 1] += d * (1.0f - a0 - am);
+            }
+            else {
+                float a1 = s * (1.5f - fl);
+                row[il + 1] += d * (a1 - a0);
+                for (int i = il + 2; i < ir - 1; ++i)
+                    row[i] += d * s;
+                float a2 = a1 + (ir - il - 3) * s;
+                row[ir - 1] += d * (1.0f - a2 - am);
+            }
+            row[ir] += d * am;
+        }
+    }
+}
+
+// turns one row of signed areas into 8-bit coverage with a running sum;
+// the absolute value clamped to one is the non-zero winding rule
+static void ResolveRow(const float *accumulation, int width, unsigned char *coverage)
+{
+    int x = 0;
+
+#if defined(RASTERIZER_SSE2)
+    // prefix sum four cells at a time: shift-and-add within the vector,
+    // then add the total carried from the vectors before
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 full = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 carry = _mm_setzero_ps();
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128 v = _mm_loadu_ps(accumulation + x);
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+        v = _mm_add_ps(v, carry);
+        carry = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m128 c = _mm_min_ps(_mm_and_ps(v, absMask), one);
+        __m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, full), half));
+        i = _mm_packs_epi32(i, i);
+        i = _mm_packus_epi16(i, i);
+        int packed = _mm_cvtsi128_si32(i);
+        copy(reinterpret_cast<unsigned char *>(&packed),
+             reinterpret_cast<unsigned char *>(&packed) + 4, coverage + x);
+    }
+
+    float sum = _mm_cvtss_f32(carry);
+#else
+    float sum = 0.0f;
+#endif
+
+    for (; x < width; ++x)
+    {
+        sum += accumulation[x];
+        float c = min(fabs(sum), 1.0f);
+        coverage[x] = static_cast<unsigned char>(c * 255.0f + 0.5f);
+    }
+}
+
+void GlyphRasterizer::RasterizeBand(int firstRow, int lastRow, const vector<float> *lines,
+                                    unsigned char *coverage)
+{
+    float *accumulation = m_accumulation.data() + size_t(firstRow) * m_stride;
+    fill(accumulation, accumulation + size_t(lastRow - firstRow) * m_stride, 0.0f);
+
+    const float *l = lines->data();
+    for (size_t i = 0; i < lines->size(); i += 4)
+        AccumulateLine(accumulation, m_stride, m_width, firstRow, lastRow,
+                       l[i], l[i + 1], l[i + 2], l[i + 3]);
+
+    for (int y = firstRow; y < lastRow; ++y)
+        ResolveRow(accumulation + size_t(y - firstRow) * m_stride, m_width,
+                   coverage + size_t(y) * m_width);
+}
+
+void GlyphRasterizer::Rasterize(vector<unsigned char> &coverage, unsigned int threads)
+{
+    FlushOutlines();
+    coverage.resize(size_t(m_width) * m_height);
+
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    threads = max(1u, min(threads, unsigned(m_height)));
+    if (threads == 1) {
+        if (m_height > 0)
+            RasterizeBand(0, m_height, &m_lines, coverage.data());
+        m_lines.clear();
+        return;
+    }
+
+    // bands of rows are independent: each keeps its own part of the
+    // accumulation buffer and gets the lines that cross it
+    int band = (m_height + threads - 1) / threads;
+    m_bands.resize(threads);
+    for (unsigned int i = 0; i < threads; ++i)
+        m_bands[i].clear();
+    for (size_t i = 0; i < m_lines.size(); i += 4)
+    {
+        float y0 = min(m_lines[i + 1], m_lines[i + 3]);
+        float y1 = max(m_lines[i + 1], m_lines[i + 3]);
+        int first = max(0, int(y0) / band);
+        int last = min(int(threads) - 1, int(y1) / band);
+        for (int b = first; b <= last; ++b)
+            m_bands[b].insert(m_bands[b].end(), m_lines.begin() + i, m_lines.begin() + i + 4);
+    }
+
+    vector<thread> pool;
+    for (unsigned int i = 1; i < threads; ++i) {
+        int first = i * band;
+        if (first >= m_height) break;
+        pool.push_back(thread(&GlyphRasterizer::RasterizeBand, this, first,
+                              min(m_height, first + band), &m_bands[i], coverage.data()));
+    }
+
+    // the calling thread takes the first band
+    RasterizeBand(0, min(m_height, band), &m_bands[0], coverage.data());
+    for (size_t i = 0; i < pool.size(); ++i)
+        pool[i].join();
+
+    m_lines.clear();
+}
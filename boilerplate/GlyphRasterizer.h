@@ -0,0 +1,73 @@
+// ==========================================================================
+// Software rasterizer for filled glyphs
+//
+// Fills glyph outlines into anti-aliased coverage masks on the CPU, with no
+// OpenGL involved. Outlines are flattened into lines, and every line adds
+// the signed area it covers in each pixel to an accumulation buffer; a
+// running sum along each row then gives the winding-weighted coverage,
+// which is clamped to [0, 1] to fill with the non-zero winding rule. The
+// row sums are vectorized, and rows can be split into bands that are
+// rasterized on separate threads.
+// ==========================================================================
+#ifndef GLYPHRASTERIZER_H
+#define GLYPHRASTERIZER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "GlyphExtractor.h"
+#include "BezierFlattener.h"
+
+class GlyphRasterizer
+{
+    int m_width;
+    int m_height;
+
+    // outlines are queued in pixels with y up, and flattened when rasterized
+    BezierFlattener m_flattener;
+
+    // lines as x0, y0, x1, y1 in pixels with y down, so row 0 is the top
+    std::vector<float> m_lines;
+
+    // the lines crossing each band of rows, when rasterizing on threads
+    std::vector<std::vector<float> > m_bands;
+
+    // one row of signed area per scanline, padded for the lines' overhang
+    // and to a whole number of vectors
+    std::vector<float> m_accumulation;
+    int m_stride;
+
+    void FlushOutlines();
+    void RasterizeBand(int firstRow, int lastRow, const std::vector<float> *lines,
+                       unsigned char *coverage);
+
+public:
+    // the largest distance flattened outlines stray from the curves, in pixels
+    static const float TOLERANCE;
+
+    GlyphRasterizer();
+
+    // sets the size of the coverage mask and discards anything queued
+    void Resize(int width, int height);
+
+    int Width() const   { return m_width; }
+    int Height() const  { return m_height; }
+
+    // queues a glyph with its origin at pixel (x, y), measured from the
+    // bottom left, scaled from EM units to pixels by size
+    void AddGlyph(const MyPackedGlyph &glyph, float x, float y, float size);
+
+    // queues line vertex pairs, in pixels from the bottom left
+    void AddLines(const float *lines, size_t count);
+
+    // fills everything queued into a width x height mask of 8-bit coverage,
+    // top row first, splitting the rows between threads (0 for one per core),
+    // then clears the queue
+    void Rasterize(std::vector<unsigned char> &coverage, unsigned int threads = 1);
+
+    // discards everything queued
+    void Clear();
+};
+
+// --------------------------------------------------------------------------
+#endif // GLYPHRASTERIZER_H
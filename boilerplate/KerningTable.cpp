@@ -0,0 +1,341 @@
+// ==========================================================================
+// Kerning pair tables
+// ==========================================================================
+
+#include "KerningTable.h"
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include FT_TRUETYPE_TABLES_H
+#include FT_TRUETYPE_TAGS_H
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+// OpenType GPOS pair adjustment reading
+
+namespace {
+
+// big-endian reads from a font table; anything out of bounds reads as zero,
+// so a damaged table yields no kerning rather than a crash
+struct TableReader
+{
+    const unsigned char *data;
+    size_t size;
+
+    unsigned int U16(size_t offset) const
+    {
+        return offset + 2 <= size ? (data[offset] << 8) | data[offset + 1] : 0;
+    }
+    int S16(size_t offset) const
+    {
+        return static_cast<short>(U16(offset));
+    }
+    unsigned int U32(size_t offset) const
+    {
+        return (U16(offset) << 16) | U16(offset + 2);
+    }
+};
+
+// class of a glyph in a class definition table (0 for unlisted glyphs)
+unsigned int GlyphClass(const TableReader &table, size_t classDef, unsigned int glyph)
+{
+    unsigned int format = table.U16(classDef);
+    if (format == 1) {
+        unsigned int start = table.U16(classDef + 2);
+        unsigned int count = table.U16(classDef + 4);
+        return glyph >= start && glyph < start + count ? table.U16(classDef + 6 + 2 * (glyph - start)) : 0;
+    }
+    if (format == 2) {
+        int low = 0, high = int(table.U16(classDef + 2)) - 1;
+        while (low <= high) {
+            int middle = (low + high) / 2;
+            size_t range = classDef + 4 + 6 * middle;
+            unsigned int start = table.U16(range), end = table.U16(range + 2);
+            if (glyph >= start && glyph <= end) return table.U16(range + 4);
+            if (end < glyph) low = middle + 1; else high = middle - 1;
+        }
+    }
+    return 0;
+}
+
+// size in bytes of a value record, and where its x advance is within it
+// (-1 if it has none)
+int ValueRecordSize(unsigned int format)
+{
+    int size = 0;
+    for (; format; format >>= 1)
+        size += (format & 1) * 2;
+    return size;
+}
+
+int XAdvanceOffset(unsigned int format)
+{
+    if (!(format & 0x4)) return -1;
+    return ((format & 0x1) ? 2 : 0) + ((format & 0x2) ? 2 : 0);
+}
+
+// the font's characters, as (glyph, index into the character list) sorted by
+// glyph so that every character drawn with a glyph can be found
+typedef vector<pair<unsigned int, size_t> > GlyphCharacters;
+
+// the first of the characters drawn with a glyph, or with any later one
+GlyphCharacters::const_iterator FirstCharacter(const GlyphCharacters &byGlyph, unsigned int glyph)
+{
+    return lower_bound(byGlyph.begin(), byGlyph.end(), make_pair(glyph, size_t(0)));
+}
+
+// calls visit(character, coverage index) for each of the characters whose
+// glyph a coverage table lists, going through the table's own entries so
+// that the work is in proportion to what it covers
+template <class Visit>
+void VisitCovered(const TableReader &table, size_t coverage, const GlyphCharacters &byGlyph, Visit visit)
+{
+    unsigned int format = table.U16(coverage);
+    unsigned int count = table.U16(coverage + 2);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        unsigned int start, end, index;
+        if (format == 1) {
+            start = end = table.U16(coverage + 4 + 2 * i);
+            index = i;
+        }
+        else if (format == 2) {
+            size_t range = coverage + 4 + 6 * i;
+            start = table.U16(range);
+            end = table.U16(range + 2);
+            index = table.U16(range + 4);
+        }
+        else {
+            return;
+        }
+
+        GlyphCharacters::const_iterator c = FirstCharacter(byGlyph, start);
+        for (; c != byGlyph.end() && c->first <= end; ++c)
+            visit(c->second, index + (c->first - start));
+    }
+}
+
+// reads one pair adjustment subtable; the first subtable of a lookup to cover
+// a pair decides it, so pairs already present in this lookup are kept
+void ReadPairSubtable(const TableReader &table, size_t subtable,
+                      const vector<int> &characters, const vector<unsigned int> &glyphs,
+                      const GlyphCharacters &byGlyph, KerningTable::PairMap &pairs)
+{
+    unsigned int format = table.U16(subtable);
+    size_t coverage = subtable + table.U16(subtable + 2);
+    unsigned int format1 = table.U16(subtable + 4);
+    unsigned int format2 = table.U16(subtable + 6);
+    int size1 = ValueRecordSize(format1), size2 = ValueRecordSize(format2);
+    int advance = XAdvanceOffset(format1);
+
+    if (format == 1)
+    {
+        // explicit pairs, sorted by second glyph; zero adjustments are kept
+        // too, as they override class kerning in later subtables
+        VisitCovered(table, coverage, byGlyph, [&](size_t i, unsigned int index) {
+            unsigned long long left = static_cast<unsigned long long>(static_cast<unsigned int>(characters[i])) << 32;
+            size_t pairSet = subtable + table.U16(subtable + 10 + 2 * index);
+            unsigned int count = table.U16(pairSet);
+            size_t record = pairSet + 2;
+            for (unsigned int p = 0; p < count; ++p, record += 2 + size1 + size2)
+            {
+                unsigned int second = table.U16(record);
+                float value = advance < 0 ? 0.0f : float(table.S16(record + 2 + advance));
+                GlyphCharacters::const_iterator c = FirstCharacter(byGlyph, second);
+                for (; c != byGlyph.end() && c->first == second; ++c)
+                    pairs.insert(make_pair(left | static_cast<unsigned int>(characters[c->second]), value));
+            }
+        });
+    }
+    else if (format == 2 && advance >= 0)
+    {
+        // adjustments by class of the first and second glyph; the characters
+        // of each second class, and the classes each first class is kerned
+        // against, are found once for the subtable
+        size_t classDef1 = subtable + table.U16(subtable + 8);
+        size_t classDef2 = subtable + table.U16(subtable + 10);
+        unsigned int class1Count = table.U16(subtable + 12);
+        unsigned int class2Count = table.U16(subtable + 14);
+
+        vector<vector<size_t> > byClass2(class2Count);
+        for (size_t j = 0; j < characters.size(); ++j) {
+            unsigned int class2 = GlyphClass(table, classDef2, glyphs[j]);
+            if (class2 < class2Count)
+                byClass2[class2].push_back(j);
+        }
+
+        vector<vector<pair<unsigned int, int> > > rows(class1Count);
+        vector<bool> rowRead(class1Count, false);
+        VisitCovered(table, coverage, byGlyph, [&](size_t i, unsigned int) {
+            unsigned int class1 = GlyphClass(table, classDef1, glyphs[i]);
+            if (class1 >= class1Count)
+                return;
+            vector<pair<unsigned int, int> > &row = rows[class1];
+            if (!rowRead[class1]) {
+                size_t record = subtable + 16 + size_t(class1) * class2Count * (size1 + size2);
+                for (unsigned int class2 = 0; class2 < class2Count; ++class2) {
+                    int value = table.S16(record + class2 * (size1 + size2) + advance);
+                    if (value != 0)
+                        row.push_back(make_pair(class2, value));
+                }
+                rowRead[class1] = true;
+            }
+
+            unsigned long long left = static_cast<unsigned long long>(static_cast<unsigned int>(characters[i])) << 32;
+            for (size_t k = 0; k < row.size(); ++k) {
+                const vector<size_t> &seconds = byClass2[row[k].first];
+                for (size_t j = 0; j < seconds.size(); ++j)
+                    pairs.insert(make_pair(left | static_cast<unsigned int>(characters[seconds[j]]), float(row[k].second)));
+            }
+        });
+    }
+}
+
+// reads the pair adjustments of every lookup in the GPOS 'kern' feature,
+// returning false if the font has none
+bool ReadGlyphPositioning(FT_Face face, const vector<int> &characters,
+                          const vector<unsigned int> &glyphs, const GlyphCharacters &byGlyph,
+                          KerningTable &kerning)
+{
+    FT_ULong length = 0;
+    if (FT_Load_Sfnt_Table(face, TTAG_GPOS, 0, 0, &length) || length == 0)
+        return false;
+    vector<unsigned char> data(length);
+    if (FT_Load_Sfnt_Table(face, TTAG_GPOS, 0, &data[0], &length))
+        return false;
+    TableReader table = { &data[0], data.size() };
+
+    size_t featureList = table.U16(6);
+    size_t lookupList = table.U16(8);
+
+    // lookups used by any 'kern' feature, in lookup order
+    vector<unsigned int> lookups;
+    unsigned int featureCount = table.U16(featureList);
+    for (unsigned int i = 0; i < featureCount; ++i)
+    {
+        size_t record = featureList + 2 + 6 * i;
+        if (table.U32(record) != FT_MAKE_TAG('k', 'e', 'r', 'n')) continue;
+        size_t feature = featureList + table.U16(record + 4);
+        unsigned int count = table.U16(feature + 2);
+        for (unsigned int j = 0; j < count; ++j)
+            lookups.push_back(table.U16(feature + 4 + 2 * j));
+    }
+    sort(lookups.begin(), lookups.end());
+    lookups.erase(unique(lookups.begin(), lookups.end()), lookups.end());
+    if (lookups.empty())
+        return false;
+
+    float em = float(face->units_per_EM);
+    for (size_t l = 0; l < lookups.size(); ++l)
+    {
+        size_t lookup = lookupList + table.U16(lookupList + 2 + 2 * lookups[l]);
+        unsigned int type = table.U16(lookup);
+        unsigned int subtableCount = table.U16(lookup + 4);
+
+        KerningTable::PairMap pairs;
+        for (unsigned int s = 0; s < subtableCount; ++s)
+        {
+            size_t subtable = lookup + table.U16(lookup + 6 + 2 * s);
+
+            // extension subtables point on to the real one with a 32-bit offset
+            unsigned int subtableType = type;
+            if (type == 9) {
+                subtableType = table.U16(subtable + 2);
+                subtable += table.U32(subtable + 4);
+            }
+            if (subtableType == 2)
+                ReadPairSubtable(table, subtable, characters, glyphs, byGlyph, pairs);
+        }
+
+        // lookups apply one after another, so their adjustments add up
+        for (KerningTable::PairMap::const_iterator p = pairs.begin(); p != pairs.end(); ++p)
+            if (p->second != 0.0f)
+                kerning.Add(int(p->first >> 32), int(p->first & 0xffffffffu), p->second / em);
+    }
+
+    return true;
+}
+
+// reads the pairs of the legacy 'kern' table the way FT_Get_Kerning applies
+// them: horizontal format 0 subtables add up, and one marked as overriding
+// replaces what those before it gave a pair; the pairs are walked as listed,
+// rather than asking FreeType about every two characters
+void ReadKerningTable(FT_Face face, const vector<int> &characters,
+                      const GlyphCharacters &byGlyph, KerningTable &kerning)
+{
+    FT_ULong length = 0;
+    if (FT_Load_Sfnt_Table(face, TTAG_kern, 0, 0, &length) || length == 0)
+        return;
+    vector<unsigned char> data(length);
+    if (FT_Load_Sfnt_Table(face, TTAG_kern, 0, &data[0], &length))
+        return;
+    TableReader table = { &data[0], data.size() };
+
+    // adjustments by left and right glyph
+    unordered_map<unsigned int, int> adjustments;
+    unsigned int subtableCount = table.U16(2);
+    size_t subtable = 4;
+    for (unsigned int s = 0; s < subtableCount && subtable + 14 <= table.size; ++s)
+    {
+        unsigned int coverage = table.U16(subtable + 4);
+        if ((coverage & ~8u) == 0x0001)
+        {
+            size_t count = min<size_t>(table.U16(subtable + 6), (table.size - subtable - 14) / 6);
+            for (size_t p = 0; p < count; ++p)
+            {
+                size_t record = subtable + 14 + 6 * p;
+                unsigned int pair = table.U32(record);
+                int value = table.S16(record + 4);
+                if (coverage & 8)
+                    adjustments[pair] = value;
+                else
+                    adjustments[pair] += value;
+            }
+        }
+        subtable += table.U16(subtable + 2);
+    }
+
+    float em = float(face->units_per_EM);
+    for (unordered_map<unsigned int, int>::const_iterator a = adjustments.begin(); a != adjustments.end(); ++a)
+    {
+        if (a->second == 0) continue;
+        unsigned int leftGlyph = a->first >> 16, rightGlyph = a->first & 0xffffu;
+        for (GlyphCharacters::const_iterator l = FirstCharacter(byGlyph, leftGlyph);
+             l != byGlyph.end() && l->first == leftGlyph; ++l)
+        {
+            for (GlyphCharacters::const_iterator r = FirstCharacter(byGlyph, rightGlyph);
+                 r != byGlyph.end() && r->first == rightGlyph; ++r)
+                kerning.Add(characters[l->second], characters[r->second], a->second / em);
+        }
+    }
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+void KerningTable::Build(FT_Face face, const vector<int> &characters)
+{
+    m_pairs.clear();
+    if (!face)
+        return;
+
+    vector<unsigned int> glyphs(characters.size());
+    GlyphCharacters byGlyph;
+    for (size_t i = 0; i < characters.size(); ++i) {
+        glyphs[i] = FT_Get_Char_Index(face, characters[i]);
+        byGlyph.push_back(make_pair(glyphs[i], i));
+    }
+    sort(byGlyph.begin(), byGlyph.end());
+
+    // OpenType kerning takes precedence over the old table, as in shapers
+    if (!ReadGlyphPositioning(face, characters, glyphs, byGlyph, *this) && FT_HAS_KERNING(face))
+        ReadKerningTable(face, characters, byGlyph, *this);
+}
+
+void KerningTable::Add(int left, int right, float adjustment)
+{
+    m_pairs[Key(left, right)] += adjustment;
+}
@@ -0,0 +1,58 @@
+// ==========================================================================
+// Kerning pair tables
+//
+// Holds the horizontal adjustment between pairs of characters in a hash
+// table, so text layout can apply kerning with a single probe per pair
+// instead of asking FreeType. Tables are built once per font from the pair
+// adjustments of the OpenType GPOS 'kern' feature, or from the legacy 'kern'
+// table for fonts without one, walking the pairs and classes the tables
+// list rather than trying every two characters, and are stored in outline
+// packs alongside the glyphs.
+// ==========================================================================
+#ifndef KERNINGTABLE_H
+#define KERNINGTABLE_H
+
+#include <unordered_map>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+class KerningTable
+{
+public:
+    typedef std::unordered_map<unsigned long long, float> PairMap;
+
+private:
+    PairMap m_pairs;
+
+    static unsigned long long Key(int left, int right)
+    {
+        return (static_cast<unsigned long long>(static_cast<unsigned int>(left)) << 32) |
+               static_cast<unsigned int>(right);
+    }
+
+public:
+    // reads the adjustments between every two of the given characters from a
+    // face, replacing the table's contents
+    void Build(FT_Face face, const std::vector<int> &characters);
+
+    // adds to the adjustment between two characters, in EM units
+    void Add(int left, int right, float adjustment);
+
+    // the adjustment to add to the left character's advance, in EM units
+    float Find(int left, int right) const
+    {
+        PairMap::const_iterator pair = m_pairs.find(Key(left, right));
+        return pair == m_pairs.end() ? 0.0f : pair->second;
+    }
+
+    size_t Size() const     { return m_pairs.size(); }
+    void Clear()            { m_pairs.clear(); }
+
+    // every pair, with the left character in the high 32 bits of the key
+    const PairMap &Pairs() const    { return m_pairs; }
+};
+
+// --------------------------------------------------------------------------
+#endif // KERNINGTABLE_H
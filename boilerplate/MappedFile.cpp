@@ -0,0 +1,106 @@
+// ==========================================================================
+// Read-only memory-mapped file support
+// ==========================================================================
+
+#include "MappedFile.h"
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+MappedFile::MappedFile()
+    : m_data(0), m_size(0)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE), m_mapping(0)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+// --------------------------------------------------------------------------
+
+bool MappedFile::Open(const string &filename)
+{
+    Close();
+
+#ifdef _WIN32
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        cout << "MappedFile ERROR: could not open " << filename << endl;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(m_file, &size);
+    m_size = static_cast<size_t>(size.QuadPart);
+
+    if (m_size > 0) {
+        m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+        if (m_mapping)
+            m_data = static_cast<const unsigned char *>(
+                MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cout << "MappedFile ERROR: could not open " << filename << endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0)
+        m_size = static_cast<size_t>(info.st_size);
+
+    if (m_size > 0) {
+        void *data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+            m_data = static_cast<const unsigned char *>(data);
+    }
+
+    // the mapping keeps its own reference to the file
+    close(fd);
+#endif
+
+    if (!m_data) {
+        cout << "MappedFile ERROR: could not map " << filename << endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+    m_mapping = 0;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data) munmap(const_cast<unsigned char *>(m_data), m_size);
+#endif
+
+    m_data = 0;
+    m_size = 0;
+}
+
+// --------------------------------------------------------------------------
@@ -0,0 +1,45 @@
+// ==========================================================================
+// Read-only memory-mapped file support
+//
+// A MappedFile maps the whole of a file into the address space once, so the
+// data can be handed to FreeType (or parsed in place) without reading it into
+// heap memory. Pages are shared with the OS file cache and can be evicted
+// under memory pressure, which keeps resident memory bounded even when many
+// fonts are open at once.
+// ==========================================================================
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+class MappedFile
+{
+    const unsigned char    *m_data;
+    size_t                  m_size;
+
+#ifdef _WIN32
+    void   *m_file;
+    void   *m_mapping;
+#endif
+
+    // mappings are owned uniquely
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // maps the given file read-only, returning true if successful
+    bool Open(const std::string &filename);
+
+    // unmaps the file, if one is mapped
+    void Close();
+
+    const unsigned char *Data() const   { return m_data; }
+    size_t Size() const                 { return m_size; }
+};
+
+// --------------------------------------------------------------------------
+#endif // MAPPEDFILE_H
@@ -0,0 +1,165 @@
+// ==========================================================================
+// Offscreen OpenGL context support
+// ==========================================================================
+
+#include "OffscreenContext.h"
+#include <iostream>
+
+#include <glad/glad.h>
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#else
+#include <GLFW/glfw3.h>
+#endif
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+OffscreenContext::OffscreenContext()
+#if defined(__linux__)
+    : m_display(0), m_context(0)
+#else
+    : m_window(0)
+#endif
+{
+}
+
+OffscreenContext::~OffscreenContext()
+{
+    Destroy();
+}
+
+// --------------------------------------------------------------------------
+#if defined(__linux__)
+
+bool OffscreenContext::Create(int major, int minor)
+{
+    Destroy();
+
+    // prefer Mesa's surfaceless platform, which needs no display server at all
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint eglMajor, eglMinor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) {
+        cout << "EGL ERROR: could not initialize a display" << endl;
+        return false;
+    }
+    m_display = display;
+
+    // we render into framebuffer objects only, so no surface is needed
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, 0,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) ||
+        !eglChooseConfig(display, configAttributes, &config, 1, &configCount) ||
+        configCount == 0)
+    {
+        cout << "EGL ERROR: no OpenGL configuration available" << endl;
+        Destroy();
+        return false;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        Destroy();
+        return false;
+    }
+    m_context = context;
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) ||
+        !gladLoadGLLoader(ProcAddress))
+    {
+        cout << "EGL ERROR: could not make the context current" << endl;
+        Destroy();
+        return false;
+    }
+
+    return true;
+}
+
+void OffscreenContext::Destroy()
+{
+    if (m_display) {
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (m_context) eglDestroyContext(m_display, m_context);
+        eglTerminate(m_display);
+    }
+    m_display = 0;
+    m_context = 0;
+}
+
+void *OffscreenContext::ProcAddress(const char *name)
+{
+    return reinterpret_cast<void *>(eglGetProcAddress(name));
+}
+
+// --------------------------------------------------------------------------
+#else
+
+bool OffscreenContext::Create(int major, int minor)
+{
+    Destroy();
+
+    if (!glfwInit()) {
+        cout << "ERROR: GLFW failed to initialize" << endl;
+        return false;
+    }
+
+    // an invisible window provides the context; its default framebuffer is
+    // never drawn to
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow *window = glfwCreateWindow(16, 16, "offscreen", 0, 0);
+    if (!window) {
+        glfwTerminate();
+        return false;
+    }
+    m_window = window;
+
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader(ProcAddress)) {
+        cout << "GLAD init failed" << endl;
+        Destroy();
+        return false;
+    }
+
+    return true;
+}
+
+void OffscreenContext::Destroy()
+{
+    if (m_window) {
+        glfwDestroyWindow(static_cast<GLFWwindow *>(m_window));
+        glfwTerminate();
+    }
+    m_window = 0;
+}
+
+void *OffscreenContext::ProcAddress(const char *name)
+{
+    return reinterpret_cast<void *>(glfwGetProcAddress(name));
+}
+
+#endif
+// --------------------------------------------------------------------------
@@ -0,0 +1,44 @@
+// ==========================================================================
+// Offscreen OpenGL context support
+//
+// Creates an OpenGL core profile context that is not attached to a visible
+// window, for rendering into framebuffer objects on machines without a
+// display. On Linux this uses EGL with a surfaceless context (which Mesa
+// provides on GPU drivers and on llvmpipe); elsewhere it falls back to a
+// hidden GLFW window. Function pointers are loaded through GLAD once the
+// context is current.
+// ==========================================================================
+#ifndef OFFSCREENCONTEXT_H
+#define OFFSCREENCONTEXT_H
+
+class OffscreenContext
+{
+#if defined(__linux__)
+    void   *m_display;
+    void   *m_context;
+#else
+    void   *m_window;
+#endif
+
+    // contexts are owned uniquely
+    OffscreenContext(const OffscreenContext &);
+    OffscreenContext &operator=(const OffscreenContext &);
+
+public:
+    OffscreenContext();
+    ~OffscreenContext();
+
+    // creates a core profile context of the given version, makes it current
+    // and loads OpenGL functions, returning true if successful
+    bool Create(int major, int minor);
+
+    // releases the context, if one was created
+    void Destroy();
+
+    // address of an OpenGL function in the current offscreen context, for
+    // loading functions beyond those GLAD provides
+    static void *ProcAddress(const char *name);
+};
+
+// --------------------------------------------------------------------------
+#endif // OFFSCREENCONTEXT_H
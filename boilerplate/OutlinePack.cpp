@@ -0,0 +1,264 @@
+// ==========================================================================
+// Precompiled outline packs
+// ==========================================================================
+
+#include "OutlinePack.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+// orders index entries by character, for binary search
+bool EntryBefore(const OutlinePackEntry &entry, unsigned int character)
+{
+    return entry.character < character;
+}
+
+// appends raw bytes to a growing file image
+void Append(vector<unsigned char> &image, const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    image.insert(image.end(), bytes, bytes + size);
+}
+
+// checks that a record's arrays describe an outline that can be walked
+// without leaving them: degrees of 1 to 3, segments whose control points
+// are all among the glyph's points, and contours that split the segments
+// into consecutive runs
+bool ValidRecord(const OutlinePackRecord *record)
+{
+    const float *points = reinterpret_cast<const float *>(record + 1);
+    const unsigned int *segments = reinterpret_cast<const unsigned int *>(points + 2 * size_t(record->pointCount));
+    const unsigned int *contours = segments + record->segmentCount;
+    const unsigned char *degrees = reinterpret_cast<const unsigned char *>(contours + record->contourCount + 1);
+
+    for (unsigned int s = 0; s < record->segmentCount; ++s) {
+        if (degrees[s] < 1 || degrees[s] > 3 ||
+            segments[s] >= record->pointCount || degrees[s] >= record->pointCount - segments[s])
+            return false;
+    }
+
+    if (contours[0] != 0 || contours[record->contourCount] != record->segmentCount)
+        return false;
+    for (unsigned int c = 0; c < record->contourCount; ++c) {
+        if (contours[c+1] < contours[c])
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+string OutlinePackFilename(const string &fontFilename)
+{
+    return fontFilename + ".gpk";
+}
+
+// --------------------------------------------------------------------------
+
+bool WriteOutlinePack(const GlyphExtractor &extractor, const string &filename)
+{
+    FontHandle font = extractor.CurrentFont();
+    if (font < 0) {
+        cout << "OutlinePack ERROR: No font loaded!" << endl;
+        return false;
+    }
+
+    // decode every glyph in the font, in parallel; the character map is
+    // already in increasing order, which the index relies on
+    vector<int> characters = extractor.CharacterCodes();
+    vector<MyPackedGlyphStorage> glyphs = extractor.ExtractGlyphs(characters);
+    if (glyphs.size() != characters.size())
+        return false;
+
+    OutlinePackHeader header;
+    memcpy(header.magic, "GPAK", 4);
+    header.version = OUTLINE_PACK_VERSION;
+    header.sourceHash = extractor.Registry().Hash(font);
+    header.glyphCount = static_cast<unsigned int>(characters.size());
+    header.indexOffset = sizeof(OutlinePackHeader);
+
+    // lay out the records after the index
+    vector<OutlinePackEntry> index(characters.size());
+    vector<unsigned char> records;
+    size_t recordBase = header.indexOffset + index.size() * sizeof(OutlinePackEntry);
+
+    for (size_t i = 0; i < characters.size(); ++i)
+    {
+        MyPackedGlyph glyph = glyphs[i].View();
+
+        OutlinePackRecord record;
+        record.advance = glyph.advance;
+        for (int j = 0; j < 4; ++j)
+            record.bounds[j] = glyph.bounds[j];
+        record.contourCount = glyph.contourCount;
+        record.segmentCount = glyph.segmentCount;
+        record.pointCount = glyph.pointCount;
+
+        index[i].character = static_cast<unsigned int>(characters[i]);
+        index[i].recordOffset = static_cast<unsigned int>(recordBase + records.size());
+
+        // the packed arrays are contiguous, starting with the points
+        Append(records, &record, sizeof(record));
+        if (glyph.points)
+            Append(records, glyph.points, MyPackedGlyphStorage::Bytes(
+                glyph.contourCount, glyph.segmentCount, glyph.pointCount));
+
+        // keep the next record 4-byte aligned
+        records.resize((records.size() + 3) & ~size_t(3), 0);
+    }
+
+    ofstream output(filename.c_str(), ios::binary);
+    if (!output) {
+        cout << "OutlinePack ERROR: could not write " << filename << endl;
+        return false;
+    }
+
+    // kerning pairs go last
+    const KerningTable::PairMap &pairs = extractor.KerningPairs().Pairs();
+    vector<OutlinePackKerning> kerning;
+    kerning.reserve(pairs.size());
+    for (KerningTable::PairMap::const_iterator p = pairs.begin(); p != pairs.end(); ++p) {
+        OutlinePackKerning pair;
+        pair.left = static_cast<unsigned int>(p->first >> 32);
+        pair.right = static_cast<unsigned int>(p->first & 0xffffffffu);
+        pair.adjustment = p->second;
+        kerning.push_back(pair);
+    }
+    header.kerningCount = static_cast<unsigned int>(kerning.size());
+    header.kerningOffset = static_cast<unsigned int>(recordBase + records.size());
+
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!index.empty())
+        output.write(reinterpret_cast<const char *>(&index[0]), index.size() * sizeof(OutlinePackEntry));
+    if (!records.empty())
+        output.write(reinterpret_cast<const char *>(&records[0]), records.size());
+    if (!kerning.empty())
+        output.write(reinterpret_cast<const char *>(&kerning[0]), kerning.size() * sizeof(OutlinePackKerning));
+
+    return output.good();
+}
+
+// --------------------------------------------------------------------------
+
+OutlinePack::OutlinePack()
+    : m_header(0), m_index(0)
+{
+}
+
+bool OutlinePack::Open(const string &filename, unsigned long long sourceHash)
+{
+    m_header = 0;
+    m_index = 0;
+
+    if (!m_file.Open(filename))
+        return false;
+
+    // check that this is a pack we can read, and that it matches the font
+    const OutlinePackHeader *header =
+        reinterpret_cast<const OutlinePackHeader *>(m_file.Data());
+    if (m_file.Size() < sizeof(OutlinePackHeader) ||
+        memcmp(header->magic, "GPAK", 4) != 0 ||
+        header->version != OUTLINE_PACK_VERSION ||
+        header->indexOffset + size_t(header->glyphCount) * sizeof(OutlinePackEntry) > m_file.Size() ||
+        header->kerningOffset + size_t(header->kerningCount) * sizeof(OutlinePackKerning) > m_file.Size())
+    {
+        cout << "OutlinePack ERROR: " << filename << " is not a version "
+             << OUTLINE_PACK_VERSION << " outline pack" << endl;
+        m_file.Close();
+        return false;
+    }
+    if (sourceHash && header->sourceHash != sourceHash)
+    {
+        cout << "OutlinePack: ignoring stale pack " << filename << endl;
+        m_file.Close();
+        return false;
+    }
+
+    // lookups read records and their arrays straight from the mapping, so
+    // every one of them must be in the file and aligned; array sizes are
+    // those of MyPackedGlyphStorage::Bytes, counted so they cannot overflow
+    const OutlinePackEntry *index = reinterpret_cast<const OutlinePackEntry *>(m_file.Data() + header->indexOffset);
+    bool intact = true;
+    for (unsigned int i = 0; intact && i < header->glyphCount; ++i)
+    {
+        unsigned long long offset = index[i].recordOffset;
+        intact = offset % 4 == 0 && offset + sizeof(OutlinePackRecord) <= m_file.Size();
+        if (intact) {
+            const OutlinePackRecord *record = reinterpret_cast<const OutlinePackRecord *>(m_file.Data() + offset);
+            unsigned long long bytes = 8ull * record->pointCount + 5ull * record->segmentCount +
+                                       4ull * (record->contourCount + 1ull);
+            intact = offset + sizeof(OutlinePackRecord) + bytes <= m_file.Size() &&
+                     ValidRecord(record);
+        }
+    }
+    if (!intact)
+    {
+        cout << "OutlinePack ERROR: " << filename << " is damaged" << endl;
+        m_file.Close();
+        return false;
+    }
+
+    m_header = header;
+    m_index = index;
+    return true;
+}
+
+bool OutlinePack::Find(int character, MyPackedGlyph &glyph) const
+{
+    if (!m_header)
+        return false;
+
+    const OutlinePackEntry *end = m_index + m_header->glyphCount;
+    const OutlinePackEntry *entry = lower_bound(m_index, end,
+        static_cast<unsigned int>(character), EntryBefore);
+    if (entry == end || entry->character != static_cast<unsigned int>(character))
+        return false;
+
+    const OutlinePackRecord *record =
+        reinterpret_cast<const OutlinePackRecord *>(m_file.Data() + entry->recordOffset);
+
+    // point the view at the arrays that follow the record
+    glyph = MyPackedGlyph();
+    glyph.advance = record->advance;
+    for (int i = 0; i < 4; ++i)
+        glyph.bounds[i] = record->bounds[i];
+    glyph.contourCount = record->contourCount;
+    glyph.segmentCount = record->segmentCount;
+    glyph.pointCount = record->pointCount;
+    glyph.points = reinterpret_cast<const float *>(record + 1);
+    glyph.segments = reinterpret_cast<const unsigned int *>(glyph.points + 2 * glyph.pointCount);
+    glyph.contours = glyph.segments + glyph.segmentCount;
+    glyph.degrees = reinterpret_cast<const unsigned char *>(glyph.contours + glyph.contourCount + 1);
+    return true;
+}
+
+vector<int> OutlinePack::CharacterCodes() const
+{
+    vector<int> characters;
+    if (m_header) {
+        characters.reserve(m_header->glyphCount);
+        for (unsigned int i = 0; i < m_header->glyphCount; ++i)
+            characters.push_back(static_cast<int>(m_index[i].character));
+    }
+    return characters;
+}
+
+void OutlinePack::ReadKerning(KerningTable &kerning) const
+{
+    if (!m_header)
+        return;
+
+    const OutlinePackKerning *pairs =
+        reinterpret_cast<const OutlinePackKerning *>(m_file.Data() + m_header->kerningOffset);
+    for (unsigned int i = 0; i < m_header->kerningCount; ++i)
+        kerning.Add(static_cast<int>(pairs[i].left), static_cast<int>(pairs[i].right), pairs[i].adjustment);
+}
+
+// --------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+// ==========================================================================
+// Precompiled outline packs
+//
+// An outline pack holds every glyph of a font already converted to the packed
+// EM-normalized form produced by GlyphExtractor, so fonts can be used without
+// loading them through FreeType at all. Packs are written offline (see the
+// --pack-font command-line option) and memory-mapped at runtime; lookups
+// return views straight into the mapping with no parsing.
+//
+// File layout (native byte order, all offsets in bytes from the file start):
+//  - OutlinePackHeader
+//  - glyphCount OutlinePackEntry records, sorted by character
+//  - per glyph, 4-byte aligned: an OutlinePackRecord followed by the packed
+//    arrays in the layout used by MyPackedGlyphStorage
+//  - kerningCount OutlinePackKerning records
+// ==========================================================================
+#ifndef OUTLINEPACK_H
+#define OUTLINEPACK_H
+
+#include <string>
+#include <vector>
+
+#include "GlyphExtractor.h"
+#include "MappedFile.h"
+
+// --------------------------------------------------------------------------
+// File structures
+
+struct OutlinePackHeader
+{
+    char            magic[4];       // "GPAK"
+    unsigned int    version;        // OUTLINE_PACK_VERSION
+    unsigned long long sourceHash;  // FontRegistry::Hash of the font file it was built from
+    unsigned int    glyphCount;
+    unsigned int    indexOffset;    // offset of the OutlinePackEntry table
+    unsigned int    kerningCount;
+    unsigned int    kerningOffset;  // offset of the OutlinePackKerning table
+};
+
+struct OutlinePackEntry
+{
+    unsigned int    character;
+    unsigned int    recordOffset;   // offset of the glyph's OutlinePackRecord
+};
+
+struct OutlinePackRecord
+{
+    float           advance;
+    float           bounds[4];
+    unsigned int    contourCount;
+    unsigned int    segmentCount;
+    unsigned int    pointCount;
+};
+
+struct OutlinePackKerning
+{
+    unsigned int    left;
+    unsigned int    right;
+    float           adjustment;     // in EM units
+};
+
+const unsigned int OUTLINE_PACK_VERSION = 5;
+
+// file name of the pack that belongs to a font file
+std::string OutlinePackFilename(const std::string &fontFilename);
+
+// converts every glyph of the extractor's current font and writes them to a
+// pack file, returning true if successful
+bool WriteOutlinePack(const GlyphExtractor &extractor, const std::string &filename);
+
+// --------------------------------------------------------------------------
+// This class serves glyph lookups from a memory-mapped outline pack.
+
+class OutlinePack
+{
+    MappedFile                  m_file;
+    const OutlinePackHeader    *m_header;
+    const OutlinePackEntry     *m_index;
+
+public:
+    OutlinePack();
+
+    // maps a pack file, rejecting one whose records do not all lie within
+    // it; if sourceHash is non-zero, packs built from a font file with other
+    // contents are rejected as stale
+    bool Open(const std::string &filename, unsigned long long sourceHash = 0);
+
+    // looks up the glyph for a character, returning false if it is not in the pack
+    bool Find(int character, MyPackedGlyph &glyph) const;
+
+    // lists every character in the pack, in increasing order
+    std::vector<int> CharacterCodes() const;
+
+    // adds every kerning pair in the pack to a table
+    void ReadKerning(KerningTable &kerning) const;
+};
+
+// --------------------------------------------------------------------------
+#endif // OUTLINEPACK_H
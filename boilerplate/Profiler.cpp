@@ -0,0 +1,260 @@
+// ==========================================================================
+// CPU profiling scopes
+// ==========================================================================
+
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+// older Visual C++ only has thread-local storage for plain data
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL thread_local
+#endif
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+#if PROFILER_ENABLED
+
+namespace
+{
+    typedef chrono::steady_clock Clock;
+
+    struct Event
+    {
+        const char *name;
+        long long   start;
+        long long   end;
+    };
+
+    // A thread's events, written by the thread alone. Readers copy what they
+    // want and then check that the writer has not since begun to overwrite
+    // it: the writer notes each event it starts before touching the slot, so
+    // a reader that saw any of a newer event's fields also sees its note.
+    struct Buffer
+    {
+        atomic<const char *>    names[PROFILER_BUFFER_EVENTS];
+        atomic<long long>       starts[PROFILER_BUFFER_EVENTS];
+        atomic<long long>       ends[PROFILER_BUFFER_EVENTS];
+        atomic<unsigned long long> writing;     // the event being written
+        atomic<unsigned long long> written;     // events finished
+
+        int         thread;
+        string      threadName;                 // under the registry's mutex
+
+        Buffer() : writing(0), written(0), thread(0) {}
+
+        void Write(const char *name, long long start, long long end)
+        {
+            unsigned long long index = written.load(memory_order_relaxed);
+            unsigned int slot = static_cast<unsigned int>(index % PROFILER_BUFFER_EVENTS);
+            writing.store(index, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+            names[slot].store(name, memory_order_relaxed);
+            starts[slot].store(start, memory_order_relaxed);
+            ends[slot].store(end, memory_order_relaxed);
+            written.store(index + 1, memory_order_release);
+        }
+
+        // appends the events still held that started at or after a time
+        void Read(long long since, vector<Event> &events) const
+        {
+            unsigned long long last = written.load(memory_order_acquire);
+            unsigned long long first = last > PROFILER_BUFFER_EVENTS ? last - PROFILER_BUFFER_EVENTS : 0;
+            size_t begin = events.size();
+            for (unsigned long long index = first; index < last; ++index)
+            {
+                unsigned int slot = static_cast<unsigned int>(index % PROFILER_BUFFER_EVENTS);
+                Event event = { names[slot].load(memory_order_relaxed),
+                                starts[slot].load(memory_order_relaxed),
+                                ends[slot].load(memory_order_relaxed) };
+                events.push_back(event);
+            }
+
+            // drop any the writer may have overwritten while they were read
+            atomic_thread_fence(memory_order_acquire);
+            unsigned long long overwritten = writing.load(memory_order_relaxed) + 1;
+            size_t lost = overwritten > first + PROFILER_BUFFER_EVENTS ?
+                static_cast<size_t>(min<unsigned long long>(overwritten - first - PROFILER_BUFFER_EVENTS, last - first)) : 0;
+            events.erase(events.begin() + begin, events.begin() + begin + lost);
+
+            size_t kept = begin;
+            for (size_t i = begin; i < events.size(); ++i) {
+                if (events[i].start >= since)
+                    events[kept++] = events[i];
+            }
+            events.resize(kept);
+        }
+    };
+
+    // Every thread's buffer, which outlives the threads so their events can
+    // still be written out. The registry is never destroyed, as threads may
+    // record while the program's statics are being torn down.
+    struct Registry
+    {
+        Clock::time_point           epoch;
+        mutex                       lock;
+        vector<unique_ptr<Buffer> > buffers;
+        long long                   summarized;   // end of the last summary
+
+        Registry() : epoch(Clock::now()), summarized(0) {}
+    };
+
+    Registry &TheRegistry()
+    {
+        static Registry *registry = new Registry;
+        return *registry;
+    }
+
+    PROFILER_THREAD_LOCAL Buffer *threadBuffer = 0;
+
+    Buffer &ThreadBuffer()
+    {
+        if (!threadBuffer)
+        {
+            Registry &registry = TheRegistry();
+            lock_guard<mutex> lock(registry.lock);
+            registry.buffers.push_back(unique_ptr<Buffer>(new Buffer));
+            threadBuffer = registry.buffers.back().get();
+            threadBuffer->thread = static_cast<int>(registry.buffers.size());
+        }
+        return *threadBuffer;
+    }
+
+    // names are literals in our own code, but quote them properly anyway
+    void WriteString(ostream &out, const string &text)
+    {
+        out << '"';
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '"' || text[i] == '\\')
+                out << '\\';
+            out << (static_cast<unsigned char>(text[i]) < 32 ? ' ' : text[i]);
+        }
+        out << '"';
+    }
+}
+
+long long Profiler::Now()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(Clock::now() - TheRegistry().epoch).count();
+}
+
+void Profiler::Record(const char *name, long long start, long long end)
+{
+    ThreadBuffer().Write(name, start, end);
+}
+
+void Profiler::NameThread(const char *name)
+{
+    Buffer &buffer = ThreadBuffer();
+    lock_guard<mutex> lock(TheRegistry().lock);
+    buffer.threadName = name;
+}
+
+bool Profiler::WriteTrace(const string &filename)
+{
+    ofstream file(filename.c_str(), ios::trunc);
+    if (!file)
+        return false;
+
+    // complete events, with times in microseconds
+    Registry &registry = TheRegistry();
+    lock_guard<mutex> lock(registry.lock);
+    file << fixed << setprecision(3) << "{\"traceEvents\":[";
+    bool first = true;
+    vector<Event> events;
+    for (size_t i = 0; i < registry.buffers.size(); ++i)
+    {
+        const Buffer &buffer = *registry.buffers[i];
+        if (!buffer.threadName.empty())
+        {
+            file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                 << buffer.thread << ",\"args\":{\"name\":";
+            WriteString(file, buffer.threadName);
+            file << "}}";
+            first = false;
+        }
+
+        events.clear();
+        buffer.Read(0, events);
+        for (size_t j = 0; j < events.size(); ++j)
+        {
+            file << (first ? "\n" : ",\n") << "{\"name\":";
+            WriteString(file, events[j].name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.thread
+                 << ",\"ts\":" << events[j].start / 1000.0
+                 << ",\"dur\":" << (events[j].end - events[j].start) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+bool Profiler::Summarize(ostream &out)
+{
+    Registry &registry = TheRegistry();
+    map<string, vector<long long> > durations;
+    long long now = Now();
+    {
+        lock_guard<mutex> lock(registry.lock);
+        vector<Event> events;
+        for (size_t i = 0; i < registry.buffers.size(); ++i)
+            registry.buffers[i]->Read(registry.summarized, events);
+        for (size_t i = 0; i < events.size(); ++i)
+            durations[events[i].name].push_back(events[i].end - events[i].start);
+        registry.summarized = now;
+    }
+    if (durations.empty())
+        return false;
+
+    // each scope's median and 99th percentile, listed by the latter
+    struct Phase
+    {
+        string      name;
+        double      median;
+        double      slow;
+        size_t      count;
+
+        bool operator<(const Phase &other) const    { return slow > other.slow; }
+    };
+    vector<Phase> phases;
+    for (map<string, vector<long long> >::iterator i = durations.begin(); i != durations.end(); ++i)
+    {
+        vector<long long> &times = i->second;
+        sort(times.begin(), times.end());
+        Phase phase = { i->first, times[(times.size() - 1) / 2] / 1e6,
+                        times[(times.size() - 1) * 99 / 100] / 1e6, times.size() };
+        phases.push_back(phase);
+    }
+    sort(phases.begin(), phases.end());
+
+    ostringstream line;
+    line << fixed << setprecision(3) << "Profile (p50 / p99 ms, count):";
+    for (size_t i = 0; i < phases.size(); ++i)
+        line << (i ? "," : "") << " " << phases[i].name << " " << phases[i].median << " / "
+             << phases[i].slow << " (" << phases[i].count << ")";
+    out << line.str() << endl;
+    return true;
+}
+
+#else
+
+long long Profiler::Now()                                   { return 0; }
+void Profiler::Record(const char *, long long, long long)   {}
+void Profiler::NameThread(const char *)                     {}
+bool Profiler::WriteTrace(const string &)                   { return false; }
+bool Profiler::Summarize(ostream &)                         { return false; }
+
+#endif
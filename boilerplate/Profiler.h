@@ -0,0 +1,74 @@
+// ==========================================================================
+// CPU profiling scopes
+//
+// Times named scopes of code on any thread. Each thread records its scopes
+// into a ring buffer of its own, which only it writes, without locks; the
+// buffer keeps the most recent events and overwrites the oldest. The events
+// of every thread can be written out as a Chrome trace (to open in
+// chrome://tracing or Perfetto), or summarized per scope as the median and
+// 99th percentile of the times taken since the last summary.
+//
+// Profiling is compiled in unless PROFILER_ENABLED is defined as 0, in which
+// case scopes compile to nothing and there is nothing to write or summarize.
+// Scope names must be string literals, or otherwise outlive the program.
+// ==========================================================================
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <ostream>
+#include <string>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// events each thread keeps; older ones are overwritten
+const unsigned int PROFILER_BUFFER_EVENTS = 1 << 15;
+
+class Profiler
+{
+public:
+    // nanoseconds since the profiler's clock started
+    static long long Now();
+
+    // records a scope of the calling thread that ran from start to end
+    static void Record(const char *name, long long start, long long end);
+
+    // names the calling thread in traces
+    static void NameThread(const char *name);
+
+    // writes every event still held as a Chrome trace, returning false if
+    // the file could not be written
+    static bool WriteTrace(const std::string &filename);
+
+    // prints the median and 99th percentile time of each scope recorded
+    // since the last summary, slowest first; returns false if there were none
+    static bool Summarize(std::ostream &out);
+};
+
+#if PROFILER_ENABLED
+
+// times the enclosing block under a name
+class ProfileScope
+{
+    const char *m_name;
+    long long   m_start;
+
+    ProfileScope(const ProfileScope &);
+    ProfileScope &operator=(const ProfileScope &);
+
+public:
+    explicit ProfileScope(const char *name) : m_name(name), m_start(Profiler::Now()) {}
+    ~ProfileScope()                     { Profiler::Record(m_name, m_start, Profiler::Now()); }
+};
+
+#define PROFILE_CONCATENATE(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_CONCATENATE(profileScope, line)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_NAME(__LINE__)(name)
+
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+// --------------------------------------------------------------------------
+#endif // PROFILER_H
@@ -0,0 +1,158 @@
+// ==========================================================================
+// Program binary cache
+// ==========================================================================
+
+#include "ProgramCache.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+ProgramCache::ProgramCache()
+    : m_changed(false)
+{
+}
+
+void ProgramCache::Open(const string &filename)
+{
+    m_filename = filename;
+    m_binaries.clear();
+    m_changed = false;
+
+    ifstream file(filename.c_str(), ios::binary | ios::ate);
+    if (!file)
+        return;
+    unsigned long long remaining = static_cast<unsigned long long>(file.tellg());
+    file.seekg(0);
+
+    ProgramCacheHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, "GPRG", 4) != 0 || header.version != PROGRAM_CACHE_VERSION)
+    {
+        cout << "ProgramCache: ignoring " << filename << ", which is not a version "
+             << PROGRAM_CACHE_VERSION << " program cache" << endl;
+        m_changed = true;
+        return;
+    }
+
+    // sizes are checked against what is left of the file before anything
+    // is allocated for them
+    remaining -= sizeof(header);
+    for (unsigned int i = 0; i < header.count; ++i)
+    {
+        ProgramCacheEntry entry;
+        if (remaining < sizeof(entry) || !file.read(reinterpret_cast<char *>(&entry), sizeof(entry)) ||
+            entry.size > remaining - sizeof(entry) || m_binaries.count(entry.key))
+            break;
+        remaining -= sizeof(entry) + entry.size;
+
+        Binary &binary = m_binaries[entry.key];
+        binary.format = entry.format;
+        binary.data.resize(entry.size);
+        binary.idle = entry.idle;
+        binary.used = false;
+        if (entry.size && !file.read(reinterpret_cast<char *>(&binary.data[0]), entry.size))
+            break;
+    }
+
+    // a damaged file is dropped altogether, and rewritten
+    if (m_binaries.size() != header.count || !file)
+    {
+        cout << "ProgramCache: ignoring " << filename << ", which is damaged" << endl;
+        m_binaries.clear();
+        m_changed = true;
+    }
+}
+
+const ProgramCache::Binary *ProgramCache::Find(unsigned long long key)
+{
+    unordered_map<unsigned long long, Binary>::iterator found = m_binaries.find(key);
+    if (found == m_binaries.end())
+        return 0;
+    if (found->second.idle != 0)
+        m_changed = true;
+    found->second.idle = 0;
+    found->second.used = true;
+    return &found->second;
+}
+
+void ProgramCache::Store(unsigned long long key, unsigned int format, const void *data, size_t size)
+{
+    Binary &binary = m_binaries[key];
+    binary.format = format;
+    binary.data.assign(static_cast<const unsigned char *>(data),
+                       static_cast<const unsigned char *>(data) + size);
+    binary.idle = 0;
+    binary.used = true;
+    m_changed = true;
+}
+
+void ProgramCache::Remove(unsigned long long key)
+{
+    if (m_binaries.erase(key))
+        m_changed = true;
+}
+
+bool ProgramCache::Save()
+{
+    // binaries nobody asks for run after run belong to shaders or drivers
+    // no longer used
+    for (unordered_map<unsigned long long, Binary>::iterator binary = m_binaries.begin();
+         binary != m_binaries.end(); )
+    {
+        if (binary->second.used) {
+            ++binary;
+            continue;
+        }
+        // counted once, however often the cache is saved in a run
+        m_changed = true;
+        binary->second.used = true;
+        if (++binary->second.idle > PROGRAM_CACHE_MAX_IDLE)
+            binary = m_binaries.erase(binary);
+        else
+            ++binary;
+    }
+    if (!m_changed || m_filename.empty())
+        return true;
+
+    ofstream file(m_filename.c_str(), ios::binary | ios::trunc);
+    if (!file) {
+        cout << "ProgramCache ERROR: could not write " << m_filename << endl;
+        return false;
+    }
+
+    ProgramCacheHeader header;
+    memcpy(header.magic, "GPRG", 4);
+    header.version = PROGRAM_CACHE_VERSION;
+    header.count = static_cast<unsigned int>(m_binaries.size());
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (unordered_map<unsigned long long, Binary>::const_iterator binary = m_binaries.begin();
+         binary != m_binaries.end(); ++binary)
+    {
+        ProgramCacheEntry entry;
+        entry.key = binary->first;
+        entry.format = binary->second.format;
+        entry.size = static_cast<unsigned int>(binary->second.data.size());
+        entry.idle = binary->second.idle;
+        file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+        if (entry.size)
+            file.write(reinterpret_cast<const char *>(&binary->second.data[0]), entry.size);
+    }
+
+    m_changed = !file;
+    return !m_changed;
+}
+
+unsigned long long ProgramCache::Hash(const void *data, size_t size, unsigned long long hash)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
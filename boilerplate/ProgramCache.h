@@ -0,0 +1,94 @@
+// ==========================================================================
+// Program binary cache
+//
+// Keeps linked shader programs, as the binaries the driver hands back, in a
+// single file between runs. Each binary is stored under a 64-bit key that
+// the caller derives from everything the binary depends on: the shader
+// sources and the driver that compiled them. A changed source or driver
+// gives a different key, so a stale binary is never found. Programs
+// the driver refuses to load are simply linked again.
+//
+// Binaries not used for a number of runs in a row are dropped when the cache
+// is saved, so the file follows the shaders as they change rather than
+// growing, while a binary only some runs use is kept.
+// ==========================================================================
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ProgramCacheHeader
+{
+    char            magic[4];       // "GPRG"
+    unsigned int    version;        // PROGRAM_CACHE_VERSION
+    unsigned int    count;          // number of entries that follow
+};
+
+// each entry is followed by its binary
+struct ProgramCacheEntry
+{
+    unsigned long long  key;
+    unsigned int        format;     // the driver's binary format
+    unsigned int        size;       // bytes of binary
+    unsigned int        idle;       // runs in a row it was not used
+};
+
+const unsigned int PROGRAM_CACHE_VERSION = 1;
+
+// runs a binary may go unused before it is dropped
+const unsigned int PROGRAM_CACHE_MAX_IDLE = 8;
+
+// --------------------------------------------------------------------------
+
+class ProgramCache
+{
+public:
+    struct Binary
+    {
+        unsigned int                format;
+        std::vector<unsigned char>  data;
+        unsigned int                idle;       // runs since last used
+        bool                        used;
+    };
+
+private:
+    std::string m_filename;
+    std::unordered_map<unsigned long long, Binary> m_binaries;
+    bool m_changed;
+
+public:
+    ProgramCache();
+
+    // reads the binaries in a cache file, which will also be saved to; a
+    // missing or damaged file leaves the cache empty
+    void Open(const std::string &filename);
+
+    // the binary stored under a key (marking it used), or 0 if there is none
+    const Binary *Find(unsigned long long key);
+
+    // stores a binary under a key, replacing any there
+    void Store(unsigned long long key, unsigned int format, const void *data, size_t size);
+
+    // forgets a binary, for one the driver would not load
+    void Remove(unsigned long long key);
+
+    // writes the binaries back to the file, dropping those unused for too
+    // long; returns false if it could not be written
+    bool Save();
+
+    size_t Size() const     { return m_binaries.size(); }
+
+    // 64-bit FNV-1a hash of some bytes, continuing from a previous hash
+    static unsigned long long Hash(const void *data, size_t size,
+                                   unsigned long long hash = 14695981039346656037ull);
+    static unsigned long long Hash(const std::string &text,
+                                   unsigned long long hash = 14695981039346656037ull)
+    {
+        return Hash(text.data(), text.size(), hash);
+    }
+};
+
+// --------------------------------------------------------------------------
+#endif // PROGRAMCACHE_H
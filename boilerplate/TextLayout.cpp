@@ -0,0 +1,91 @@
+// ==========================================================================
+// Text layout
+// ==========================================================================
+
+#include "TextLayout.h"
+#include <algorithm>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+TextLayout::TextLayout(const GlyphExtractor &extractor)
+    : m_extractor(extractor), m_kerning(true), m_hits(0), m_misses(0)
+{
+}
+
+const GlyphRun &TextLayout::Layout(const string &text)
+{
+    RunKey key;
+    key.font = m_extractor.CurrentFont();
+    key.text = text;
+
+    unordered_map<RunKey, GlyphRun, RunKeyHash>::iterator found = m_runs.find(key);
+    if (found != m_runs.end()) {
+        ++m_hits;
+        return found->second;
+    }
+    ++m_misses;
+
+    GlyphRun &run = m_runs[key];
+    run.font = key.font;
+    run.advance = 0.0f;
+    run.reach[0] = run.reach[1] = 0.0f;
+    run.glyphs.reserve(text.size());
+
+    for (size_t i = 0; i < text.size(); ++i)
+        Append(run, static_cast<unsigned char>(text[i]), i > 0 ? static_cast<unsigned char>(text[i - 1]) : -1);
+
+    return run;
+}
+
+void TextLayout::Append(GlyphRun &run, int character, int previous) const
+{
+    // kerning pulls each glyph towards (or away from) the one before it
+    float x = run.advance;
+    if (m_kerning && previous >= 0)
+        x += m_extractor.Kerning(previous, character);
+
+    MyPackedGlyph outline = m_extractor.ExtractPackedGlyph(character);
+    PositionedGlyph glyph;
+    glyph.character = character;
+    glyph.x = x;
+    glyph.y = 0.0f;
+    for (int j = 0; j < 4; ++j)
+        glyph.bounds[j] = outline.bounds[j] + (j % 2 ? glyph.y : glyph.x);
+    run.glyphs.push_back(glyph);
+
+    run.reach[0] = min(run.reach[0], outline.bounds[0]);
+    run.reach[1] = max(run.reach[1], outline.bounds[2]);
+    run.advance = x + outline.advance;
+}
+
+void TextLayout::FindGlyphs(const GlyphRun &run, const float window[4], vector<size_t> &found)
+{
+    // only glyphs with x in this span can reach into the window
+    PositionedGlyph lowest, highest;
+    lowest.x = window[0] - run.reach[1];
+    highest.x = window[2] - run.reach[0];
+
+    struct ByX
+    {
+        bool operator()(const PositionedGlyph &a, const PositionedGlyph &b) const { return a.x < b.x; }
+    };
+    vector<PositionedGlyph>::const_iterator first =
+        lower_bound(run.glyphs.begin(), run.glyphs.end(), lowest, ByX());
+    vector<PositionedGlyph>::const_iterator last =
+        upper_bound(first, run.glyphs.end(), highest, ByX());
+
+    for (vector<PositionedGlyph>::const_iterator glyph = first; glyph != last; ++glyph)
+    {
+        if (glyph->bounds[0] <= window[2] && glyph->bounds[2] >= window[0] &&
+            glyph->bounds[1] <= window[3] && glyph->bounds[3] >= window[1])
+            found.push_back(glyph - run.glyphs.begin());
+    }
+}
+
+void TextLayout::UseKerning(bool use)
+{
+    m_kerning = use;
+    m_runs.clear();
+}
@@ -0,0 +1,102 @@
+// ==========================================================================
+// Text layout
+//
+// Places the glyphs of a string along a baseline, advancing by each glyph's
+// width plus the font's kerning between neighbouring characters. The result
+// is a glyph run: each character with its pen position and outline bounds,
+// in EM units. Runs are memoized by font and string, so laying out a string
+// that was seen before is a single hash lookup. The glyphs of a run that
+// fall within a window are found by binary search, so showing part of a
+// long run costs as much as the part shown.
+// ==========================================================================
+#ifndef TEXTLAYOUT_H
+#define TEXTLAYOUT_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GlyphExtractor.h"
+
+// a glyph placed in a run; glyphs are looked up by character code
+struct PositionedGlyph
+{
+    int     character;
+    float   x;
+    float   y;
+    float   bounds[4];  // outline box (xmin, ymin, xmax, ymax) in the run
+};
+
+// glyphs are in pen order, so their x only increases
+struct GlyphRun
+{
+    FontHandle                      font;
+    float                           advance;    // total width of the run
+    float                           reach[2];   // furthest any box extends left and right of its x
+    std::vector<PositionedGlyph>    glyphs;
+};
+
+// --------------------------------------------------------------------------
+// This class lays out strings in the current font of a glyph extractor.
+
+class TextLayout
+{
+    struct RunKey
+    {
+        FontHandle  font;
+        std::string text;
+
+        bool operator==(const RunKey &other) const
+        {
+            return font == other.font && text == other.text;
+        }
+    };
+
+    struct RunKeyHash
+    {
+        size_t operator()(const RunKey &key) const
+        {
+            return std::hash<std::string>()(key.text) ^ (static_cast<size_t>(key.font) * 0x9e3779b9u);
+        }
+    };
+
+    const GlyphExtractor &m_extractor;
+    std::unordered_map<RunKey, GlyphRun, RunKeyHash> m_runs;
+    bool m_kerning;
+    unsigned long m_hits;
+    unsigned long m_misses;
+
+    // runs refer to their extractor's fonts
+    TextLayout(const TextLayout &);
+    TextLayout &operator=(const TextLayout &);
+
+public:
+    explicit TextLayout(const GlyphExtractor &extractor);
+
+    // lays out a string in the extractor's current font, or returns the run
+    // from the last time; the reference stays valid until Clear()
+    const GlyphRun &Layout(const std::string &text);
+
+    // places a character at the end of a run, kerned against the character
+    // before it (-1 for none), in the extractor's current font
+    void Append(GlyphRun &run, int character, int previous) const;
+
+    // sets whether kerning is applied (on by default); forgets every run
+    void UseKerning(bool use);
+
+    // appends the indices of a run's glyphs whose boxes overlap the given
+    // window (xmin, ymin, xmax, ymax), in run order
+    static void FindGlyphs(const GlyphRun &run, const float window[4], std::vector<size_t> &found);
+
+    // forgets every run
+    void Clear()    { m_runs.clear(); }
+
+    const GlyphExtractor &Extractor() const { return m_extractor; }
+
+    // number of layouts served from memoized runs, or computed
+    unsigned long RunHits() const   { return m_hits; }
+    unsigned long RunMisses() const { return m_misses; }
+};
+
+// --------------------------------------------------------------------------
+#endif // TEXTLAYOUT_H
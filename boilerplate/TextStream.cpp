@@ -0,0 +1,160 @@
+// ==========================================================================
+// Streaming text layout
+// ==========================================================================
+
+#include "TextStream.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+// UTF-8 decoding
+
+namespace {
+
+const int REPLACEMENT_CHARACTER = 0xFFFD;
+
+// most characters laid out by one call to Cover
+const int MAX_BATCH = 1024;
+
+// decodes the character at the given position and moves past it; malformed
+// sequences decode as the replacement character, one byte at a time
+int DecodeUtf8(const unsigned char *data, size_t size, size_t &position)
+{
+    unsigned char lead = data[position++];
+    if (lead < 0x80)
+        return lead;
+
+    int length, character;
+    if ((lead & 0xE0) == 0xC0)      { length = 1; character = lead & 0x1F; }
+    else if ((lead & 0xF0) == 0xE0) { length = 2; character = lead & 0x0F; }
+    else if ((lead & 0xF8) == 0xF0) { length = 3; character = lead & 0x07; }
+    else                            return REPLACEMENT_CHARACTER;
+
+    if (position + length > size)
+        return REPLACEMENT_CHARACTER;
+    for (int i = 0; i < length; ++i) {
+        if ((data[position + i] & 0xC0) != 0x80)
+            return REPLACEMENT_CHARACTER;
+        character = (character << 6) | (data[position + i] & 0x3F);
+    }
+
+    // overlong forms, surrogates and values past Unicode are not characters
+    static const int smallest[4] = { 0, 0x80, 0x800, 0x10000 };
+    if (character < smallest[length] || character > 0x10FFFF ||
+        (character >= 0xD800 && character <= 0xDFFF))
+        return REPLACEMENT_CHARACTER;
+
+    position += length;
+    return character;
+}
+
+bool IsSpace(int character)
+{
+    return character <= 0x20 || character == 0x7F || character == 0x85 || character == 0xA0;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+TextStream::TextStream(const TextLayout &layout)
+    : m_layout(&layout)
+{
+    Rewind();
+}
+
+bool TextStream::Open(const string &filename)
+{
+    if (!m_file.Open(filename))
+        return false;
+    Rewind();
+    return true;
+}
+
+void TextStream::Rewind()
+{
+    // skip a byte order mark
+    const unsigned char *data = m_file.Data();
+    bool mark = m_file.Size() >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF;
+    m_position = mark ? 3 : 0;
+
+    m_previous = -1;
+    m_origin = 0.0;
+    m_dropped = -numeric_limits<double>::max();
+    m_characters = 0;
+    m_run.font = m_layout->Extractor().CurrentFont();
+    m_run.advance = 0.0f;
+    m_run.reach[0] = m_run.reach[1] = 0.0f;
+    m_run.glyphs.clear();
+}
+
+int TextStream::NextCharacter()
+{
+    const unsigned char *data = m_file.Data();
+    size_t size = m_file.Size();
+    if (m_position >= size)
+        return -1;
+
+    // a line of text is shown on one line, so breaks and runs of white space
+    // become a single space, and none leads the text
+    int character = DecodeUtf8(data, size, m_position);
+    if (!IsSpace(character))
+        return character;
+    while (m_position < size) {
+        size_t next = m_position;
+        if (!IsSpace(DecodeUtf8(data, size, next)))
+            break;
+        m_position = next;
+    }
+    return m_previous < 0 || m_position >= size ? NextCharacter() : ' ';
+}
+
+bool TextStream::Cover(double left, double right, double prefetch)
+{
+    vector<PositionedGlyph> &glyphs = m_run.glyphs;
+    bool changed = false;
+
+    // drop the glyphs behind the span once the first is far enough behind,
+    // then move the origin to the first glyph kept
+    if (!glyphs.empty() && m_origin + glyphs.front().bounds[2] < left - prefetch)
+    {
+        size_t count = 0;
+        while (count < glyphs.size() && m_origin + glyphs[count].bounds[2] < left) {
+            m_dropped = max(m_dropped, m_origin + glyphs[count].bounds[2]);
+            ++count;
+        }
+        glyphs.erase(glyphs.begin(), glyphs.begin() + count);
+
+        float shift = glyphs.empty() ? m_run.advance : glyphs.front().x;
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            glyphs[i].x -= shift;
+            glyphs[i].bounds[0] -= shift;
+            glyphs[i].bounds[2] -= shift;
+        }
+        m_run.advance -= shift;
+        m_origin += shift;
+        changed = true;
+    }
+
+    // lay out the glyphs coming up once the pen is within half the prefetch
+    // distance of the span, leaving room for glyphs that reach back past
+    // their pen position; a batch is limited in case the font has no width
+    // for what the file holds, and the rest is left for later calls
+    if (m_origin + m_run.advance < right + 0.5 * prefetch)
+    {
+        for (int count = 0; count < MAX_BATCH && m_origin + m_run.advance < right + prefetch; ++count)
+        {
+            int character = NextCharacter();
+            if (character < 0)
+                break;
+            m_layout->Append(m_run, character, m_previous);
+            m_previous = character;
+            ++m_characters;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
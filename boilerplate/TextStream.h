@@ -0,0 +1,78 @@
+// ==========================================================================
+// Streaming text layout
+//
+// Lays out a UTF-8 text file of any length as one endless line, only as far
+// as it is about to be seen. The file is memory mapped and decoded a glyph
+// at a time as a window moves along it; glyphs ahead of the window are laid
+// out in batches of a prefetch distance, and those that have fallen that far
+// behind are dropped. Memory and the work per move depend on the size of the
+// window, not of the file.
+//
+// The glyphs held are a glyph run whose positions are relative to a moving
+// origin, so they keep full float precision however far along the file the
+// window is.
+// ==========================================================================
+#ifndef TEXTSTREAM_H
+#define TEXTSTREAM_H
+
+#include <string>
+
+#include "MappedFile.h"
+#include "TextLayout.h"
+
+class TextStream
+{
+    const TextLayout *m_layout;
+    MappedFile m_file;
+
+    size_t m_position;      // next byte of the file to decode
+    int m_previous;         // last character laid out, for kerning (-1 for none)
+    double m_origin;        // stream position of x = 0 in the run
+    double m_dropped;       // furthest right edge of any glyph dropped so far
+    unsigned long long m_characters;
+    GlyphRun m_run;
+
+    // runs refer to their layout's fonts
+    TextStream(const TextStream &);
+    TextStream &operator=(const TextStream &);
+
+    // decodes the next character to show, collapsing white space and control
+    // characters into single spaces; returns -1 at the end of the file
+    int NextCharacter();
+
+public:
+    explicit TextStream(const TextLayout &layout);
+
+    // maps a text file and starts laying it out from the beginning, returning
+    // true if successful
+    bool Open(const std::string &filename);
+
+    // starts again from the beginning of the file, in the current font
+    void Rewind();
+
+    // starts again from the beginning in the current font of another layout
+    void UseLayout(const TextLayout &layout)    { m_layout = &layout; Rewind(); }
+
+    // makes the run hold every glyph that reaches into the span [left, right]
+    // of the stream, in EM units from its start, laying out and dropping
+    // glyphs a prefetch distance at a time; returns true if the run changed
+    bool Cover(double left, double right, double prefetch);
+
+    // the glyphs held, and the stream position of the run's origin
+    const GlyphRun &Run() const             { return m_run; }
+    double Origin() const                   { return m_origin; }
+
+    // true once the whole file has been laid out and dropped again
+    bool Finished() const   { return m_position >= m_file.Size() && m_run.glyphs.empty(); }
+
+    // the furthest any dropped glyph reached, in EM units from the start
+    // (the lowest double before any are dropped)
+    double DroppedTo() const                { return m_dropped; }
+
+    // bytes of the file decoded, and characters laid out, since the start
+    size_t BytesRead() const                        { return m_position; }
+    unsigned long long CharactersLaidOut() const    { return m_characters; }
+};
+
+// --------------------------------------------------------------------------
+#endif // TEXTSTREAM_H
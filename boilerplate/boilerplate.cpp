@@ -15,7 +15,25 @@
 #include <algorithm>
 #include <string>
 #include <iterator>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <unordered_map>
 #include "GlyphExtractor.h"
+#include "OutlinePack.h"
+#include "BezierFlattener.h"
+#include "OffscreenContext.h"
+#include "GlyphRasterizer.h"
+#include "DistanceFieldAtlas.h"
+#include "TextLayout.h"
+#include "TextStream.h"
+#include "FrameScheduler.h"
+#include "FontLoader.h"
+#include "ProgramCache.h"
+#include "Profiler.h"
 
 // Specify that we want the OpenGL core profile before including GLFW headers
 #ifdef _WIN32
@@ -42,11 +60,20 @@ void QueryGLVersion();
 bool CheckGLErrors();
 
 string LoadSource(const string &filename);
-GLuint CompileShader(GLenum shaderType, const string &source);
-GLuint LinkProgram(GLuint vertexShader, GLuint TCSshader, GLuint TESshader, GLuint fragmentShader);
-GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader);
-
-enum Font { Lora = 0, SourceSansPro, GreatVibes, AlexBrush, Inconsolata, Amatic };
+GLuint CompileShader(GLenum shaderType, const string &source, bool check = true);
+bool CheckShader(GLuint shaderObject, const string &source);
+bool LinkProgram(GLuint programObject, bool check = true);
+bool CheckProgram(GLuint programObject);
+
+enum Font { Lora = 0, SourceSansPro, GreatVibes, AlexBrush, Inconsolata, Amatic, FONT_COUNT };
+static const char *fontFiles_[FONT_COUNT] = {
+   "fonts/lora/Lora-Regular.ttf",
+   "fonts/source-sans-pro/SourceSansPro-Regular.otf",
+   "fonts/great-vibes/GreatVibes-Regular.otf",
+   "fonts/alex-brush/AlexBrush-Regular.ttf",
+   "fonts/inconsolata/Inconsolata.otf",
+   "fonts/amatic/AmaticSC-Regular.ttf"
+};
 
 // Global Variables
 static bool needsRedraw_ = true;
@@ -57,95 +84,480 @@ static Font currTextFont = AlexBrush;
 static GLfloat offset_ = 1.1f;
 static GLfloat minOffset_ = -16.0f;
 static GLfloat multiplier_ = 1.0f;
-GlyphExtractor extractor_;
+
+// Scrolling moves this many EM per step of 1/60 s (times multiplier_), and
+// frames are drawn only when something changed, waiting for input otherwise
+static const double SCROLL_STEP = 0.03;
+FrameScheduler scheduler_;
+
+// Fonts are loaded, and text laid out in them, in the background; the text
+// shown keeps drawing until the font switched to is ready, and then takes on
+// the settings the switch asked for
+FontLoader fontLoader_;
+struct MyTextSwitch
+{
+   bool     scrolling;     // scroll the text from offset_, or hold it still
+   bool     marquee;       // show the marquee file in place of the text
+   GLfloat  translation;   // where still text is placed
+   GLfloat  minOffset;     // where scrolling text starts over
+};
+static MyTextSwitch textSwitch_;
+
+// The render thread's work in each frame from a font switch being asked for
+// until the frame that shows it, to catch any frame held up by the loading
+struct MySwitchTiming
+{
+   bool                                tracking;
+   chrono::steady_clock::time_point    requested;
+   vector<double>                      frames;      // seconds of work each
+};
+static MySwitchTiming switchTiming_;
+static double keySeconds_ = 0.0;
+
+// The time from the start of the program to its first frame, by stage; the
+// fonts are preloaded on worker threads meanwhile
+struct MyStartup
+{
+   chrono::steady_clock::time_point    start;
+   chrono::steady_clock::time_point    last;
+   vector<pair<string, double> >       stages;      // milliseconds each
+   bool                                reported;
+};
+static MyStartup startup_ = { chrono::steady_clock::now(), chrono::steady_clock::now(),
+   vector<pair<string, double> >(), false };
+
+// Profiled scopes can be written out as a Chrome trace with the d key; with
+// --profile they are also written on exit and summarized every few seconds
+static string profileFile_ = "profile.json";
+static bool profiling_ = false;
+static const double PROFILE_SUMMARY_SECONDS = 2.0;
+
+// A text file can be scrolled in place of the text string; it is streamed in
+// as it scrolls, with its own offset kept in double precision
+TextStream marquee_(fontLoader_.Front().layout);
+static bool hasMarquee_ = false;
+static double marqueeOffset_ = 1.1;
+
+// View transform applied in the vertex shader: (position + translation) * scale
+static GLfloat translation_ = 0.0f;
+static GLfloat scale_ = 1.0f;
+
+// Set whenever the geometry buffers below are rebuilt and need re-uploading
+static bool geometryChanged_ = true;
+
+// Curves are flattened into lines on the CPU when the context has no
+// tessellation shaders, or on request
+static bool hasTessellation_ = true;
+static bool flattenCurves_ = false;
+BezierFlattener flattener_;
+
+// Text outlines can have their lines and quadratics raised to cubics, so
+// every segment is drawn by the cubic tessellation program in one pass
+static bool elevateCurves_ = false;
+
+// Text outlines can instead be uploaded as extracted and pulled by the
+// vertex shader, which does the elevation itself
+static bool pullVertices_ = false;
+
+// Text outline positions are stored as 16-bit fixed point in EM units
+// unless full floats are asked for
+static bool quantizePositions_ = true;
+
+// Tessellation levels adapt to how large curves are on screen unless fixed;
+// the number of primitives drawn for curves can be reported each frame
+static bool adaptiveTessellation_ = true;
+static bool reportPrimitives_ = false;
+static GLint viewportWidth_ = 512;
+static GLint viewportHeight_ = 512;
+
+// Text being shown, if any: drawn by instancing each glyph of its font
+static TextLayout *textLayout_ = 0;
+static const GlyphRun *textRun_ = 0;
+
+// Set when the text run changed in place, which only the text needs to follow
+static bool textChanged_ = false;
 
 // Geometry Buffers
 vector<GLfloat> pointVertices_;
 vector<GLfloat> pointColours_;
 vector<GLfloat> lineVertices_;
+vector<GLushort> lineIndices_;
 vector<GLfloat> lineColours_;
 vector<GLfloat> quadraticVertices_;
 vector<GLfloat> quadraticColours_;
 vector<GLfloat> cubicVertices_;
 vector<GLfloat> cubicColours_;
+vector<GLfloat> flatVertices_;
+vector<GLfloat> flatColours_;
 
 // --------------------------------------------------------------------------
 // Functions to set up OpenGL shader programs for rendering
 
 struct MyShader
 {
-   // OpenGL names for vertex and fragment shaders, shader program
-   GLuint  vertex;
-   GLuint  TCS;
-   GLuint  TES;
-   GLuint  fragment;
+   // OpenGL names for the shader program, or for the pipeline of separable
+   // programs and the programs in it running the vertex and control stages
+   // (the vertex program when there is no control stage)
    GLuint  program;
+   GLuint  pipeline;
+   GLuint  vertexProgram;
+   GLuint  controlProgram;
+
+   // locations of the view transform uniforms in the vertex shader
+   GLint   translationUniform;
+   GLint   scaleUniform;
+   GLint   positionScaleUniform;
+
+   // locations of the tessellation level uniforms in the control shader
+   GLint   viewportUniform;
+   GLint   toleranceUniform;
+   GLint   fixedLevelUniform;
+
+   // initialize program names to zero (OpenGL reserved value)
+   MyShader() : program(0), pipeline(0), vertexProgram(0), controlProgram(0),
+      translationUniform(-1), scaleUniform(-1), positionScaleUniform(-1),
+      viewportUniform(-1), toleranceUniform(-1), fixedLevelUniform(-1)
+   {}
+};
+
+// a stage of a shader program: its type and source file
+struct MyStage
+{
+   GLenum      type;
+   const char *file;
+};
+
+// a separable program used for a stage of a pipeline
+struct MyPipelineStage
+{
+   GLuint      pipeline;
+   GLbitfield  stage;
+   GLuint      program;
+};
 
-   // initialize shader and program names to zero (OpenGL reserved value)
-   MyShader() : vertex(0), TCS(0), TES(0), fragment(0), program(0)
+// Every shader program is built through a library, which loads each source
+// file once, compiles each distinct stage once however many programs use it
+// and links each distinct program once. Linked programs are kept in a binary
+// cache on disk under a hash of their sources and the driver, so later runs
+// load them instead of compiling anything. Programs can also be built
+// separable, one per stage, and combined in pipelines, so programs sharing a
+// stage share its program too.
+//
+// Compiles and links are only issued as shaders are built, and checked all
+// together once the renderer has done its other setup, so drivers that build
+// programs in the background can work while it does.
+struct MyShaderLibrary
+{
+   map<string, string>                 sources;    // by file name
+   map<pair<GLenum, string>, GLuint>   stages;     // by type and source
+   map<unsigned long long, GLuint>     programs;   // by cache key
+   vector<GLuint>                      pipelines;
+
+   ProgramCache         cache;
+   unsigned long long   driverHash;
+   bool                 binaries;   // the driver can save and load programs
+   bool                 separable;  // programs are single stages in pipelines
+   bool                 parallel;   // the driver compiles on threads of its own
+
+   // programs linked but not yet checked, with their cache keys
+   vector<pair<unsigned long long, GLuint> >   pending;
+   // and the pipeline stages that wait for them
+   vector<MyPipelineStage>                     pendingStages;
+
+   // how the programs asked for were found, for the startup report
+   int   loaded;     // from the binary cache
+   int   linked;     // from compiled stages
+   int   shared;     // already built for another shader
+
+   MyShaderLibrary() : driverHash(0), binaries(false), separable(false), parallel(false),
+      loaded(0), linked(0), shared(0)
    {}
 };
 
-// load, compile, and link shaders, returning true if successful
-bool InitializeShaders(MyShader *shader, string tcs, string tes)
+// build shader programs one per stage, in pipelines, rather than linked whole
+static bool separateShaders_ = false;
+
+// sets the number of threads the driver may compile shaders on
+typedef void (APIENTRYP MyMaxShaderCompilerThreadsProc)(GLuint count);
+
+// true if the current context lists the given extension
+bool HasExtension(const char *name)
 {
-   // load shader source from files
-   string vertexSource = LoadSource("vertex.glsl");
-   string fragmentSource = LoadSource("fragment.glsl");
-   string TCSSource = LoadSource(tcs);
-   string TESSource = LoadSource(tes);
-   if (vertexSource.empty() || fragmentSource.empty() ||
-      TCSSource.empty() || TESSource.empty())
-      return false;
+   GLint count = 0;
+   glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+   for (GLint i = 0; i < count; i++) {
+      if (strcmp(reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i)), name) == 0)
+         return true;
+   }
+   return false;
+}
 
-   // compile shader source into shader objects
-   shader->vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
-   shader->fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
-   shader->TCS = CompileShader(GL_TESS_CONTROL_SHADER, TCSSource);
-   shader->TES = CompileShader(GL_TESS_EVALUATION_SHADER, TESSource);
+// check which of its features the context supports and open the binary
+// cache; functions beyond those of the context are loaded with the loader
+void InitializeShaderLibrary(MyShaderLibrary *library, GLADloadproc load)
+{
+   GLint major = 0, minor = 0, formats = 0;
+   glGetIntegerv(GL_MAJOR_VERSION, &major);
+   glGetIntegerv(GL_MINOR_VERSION, &minor);
+   int version = 10 * major + minor;
+   if (version >= 41)
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+   library->binaries = formats > 0;
+   library->separable = separateShaders_ && version >= 41;
+   if (separateShaders_ && !library->separable)
+      cout << "Separable shader programs need OpenGL 4.1, linking whole programs instead" << endl;
+
+   // let the driver use as many threads as it likes
+   MyMaxShaderCompilerThreadsProc maxThreads = 0;
+   if (HasExtension("GL_KHR_parallel_shader_compile"))
+      maxThreads = reinterpret_cast<MyMaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsKHR"));
+   else if (HasExtension("GL_ARB_parallel_shader_compile"))
+      maxThreads = reinterpret_cast<MyMaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsARB"));
+   if (maxThreads)
+      maxThreads(0xFFFFFFFF);
+   library->parallel = maxThreads != 0;
+
+   // a binary only loads into the driver that produced it
+   const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+   library->driverHash = ProgramCache::Hash(&library->separable, sizeof(bool));
+   for (int i = 0; i < 4; i++)
+      library->driverHash = ProgramCache::Hash(string(reinterpret_cast<const char *>(glGetString(strings[i]))),
+         library->driverHash);
+
+   if (library->binaries)
+      library->cache.Open("shaders.cache");
+}
 
-   // link shader program
-   shader->program = LinkProgram(shader->vertex, shader->TCS, shader->TES, shader->fragment);
+// the source of a stage, loaded from its file the first time it is asked for
+const string &StageSource(MyShaderLibrary *library, const char *file)
+{
+   map<string, string>::iterator found = library->sources.find(file);
+   if (found != library->sources.end())
+      return found->second;
 
-   // check for OpenGL errors and return false if error occurred
-   return !CheckGLErrors();
+   string source = LoadSource(file);
+
+   // the stages drawn without tessellation use nothing beyond GLSL 3.30, so
+   // they also build on contexts too old for it
+   size_t version = source.find("#version 410");
+   if (!hasTessellation_ && version != string::npos)
+      source.replace(version, 12, "#version 330");
+
+   return library->sources[file] = source;
 }
 
-// load, compile, and link shaders, without tessellation
-bool InitializeShaders(MyShader *shader)
+// the shader object compiled from a stage's source, compiling it only once;
+// it is checked with the programs using it
+GLuint CompileStage(MyShaderLibrary *library, GLenum type, const string &source)
 {
-   // load shader source from files
-   string vertexSource = LoadSource("vertex.glsl");
-   string fragmentSource = LoadSource("fragment.glsl");
-   if (vertexSource.empty() || fragmentSource.empty())
-      return false;
+   GLuint &shader = library->stages[make_pair(type, source)];
+   if (!shader)
+      shader = CompileShader(type, source, false);
+   return shader;
+}
+
+// the program made of the given stages, loaded from the binary cache or
+// built from its sources, or 0 if its sources could not be loaded; a
+// program built from its sources is only checked by FinishShaders
+GLuint BuildProgram(MyShaderLibrary *library, const MyStage *stages, int count)
+{
+   unsigned long long key = library->driverHash;
+   for (int i = 0; i < count; i++)
+   {
+      const string &source = StageSource(library, stages[i].file);
+      if (source.empty())
+         return 0;
+      key = ProgramCache::Hash(&stages[i].type, sizeof(GLenum), key);
+      key = ProgramCache::Hash(source, key);
+   }
+
+   GLuint &program = library->programs[key];
+   if (program) {
+      library->shared++;
+      return program;
+   }
+
+   // a cached binary the driver will not take is linked again instead
+   const ProgramCache::Binary *binary = library->binaries ? library->cache.Find(key) : 0;
+   if (binary)
+   {
+      program = glCreateProgram();
+      if (library->separable)
+         glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+      glProgramBinary(program, binary->format, binary->data.data(), GLsizei(binary->data.size()));
+
+      GLint status;
+      glGetProgramiv(program, GL_LINK_STATUS, &status);
+      if (status == GL_TRUE) {
+         library->loaded++;
+         return program;
+      }
+      glDeleteProgram(program);
+      library->cache.Remove(key);
+   }
+
+   program = glCreateProgram();
+   if (library->separable)
+      glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+   if (library->binaries)
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+   for (int i = 0; i < count; i++)
+      glAttachShader(program, CompileStage(library, stages[i].type, library->sources[stages[i].file]));
+   LinkProgram(program, false);
+   library->pending.push_back(make_pair(key, program));
+   library->linked++;
+   return program;
+}
 
-   // compile shader source into shader objects
-   shader->vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
-   shader->fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+// wait for the programs linked since the last call, report any that failed
+// and store the rest in the binary cache, returning true if all linked
+bool FinishShaders(MyShaderLibrary *library)
+{
+   PROFILE_SCOPE("FinishShaders");
+   vector<GLuint> failed;
+   for (size_t i = 0; i < library->pending.size(); i++)
+   {
+      GLuint program = library->pending[i].second;
+      GLint status;
+      glGetProgramiv(program, GL_LINK_STATUS, &status);
+      if (status == GL_FALSE) {
+         failed.push_back(program);
+         continue;
+      }
+      if (!library->binaries)
+         continue;
+
+      GLint length = 0;
+      glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+      vector<unsigned char> data(length);
+      GLenum format = 0;
+      if (length > 0) {
+         glGetProgramBinary(program, length, &length, &format, data.data());
+         library->cache.Store(library->pending[i].first, format, data.data(), length);
+      }
+   }
+   library->pending.clear();
+
+   // pipelines only take programs that have linked
+   if (failed.empty())
+   {
+      for (size_t i = 0; i < library->pendingStages.size(); i++)
+         glUseProgramStages(library->pendingStages[i].pipeline, library->pendingStages[i].stage,
+            library->pendingStages[i].program);
+      library->pendingStages.clear();
+      return true;
+   }
+   library->pendingStages.clear();
+
+   // a failed link is most likely a stage that did not compile
+   for (map<pair<GLenum, string>, GLuint>::iterator i = library->stages.begin(); i != library->stages.end(); ++i)
+      CheckShader(i->second, i->first.second);
+   for (size_t i = 0; i < failed.size(); i++)
+      CheckProgram(failed[i]);
+   return false;
+}
+
+// look up the uniforms used by our shaders (-1 for those a program lacks)
+void QueryUniforms(MyShader *shader)
+{
+   shader->translationUniform = glGetUniformLocation(shader->vertexProgram, "Translation");
+   shader->scaleUniform = glGetUniformLocation(shader->vertexProgram, "Scale");
+   shader->positionScaleUniform = glGetUniformLocation(shader->vertexProgram, "PositionScale");
+   shader->viewportUniform = glGetUniformLocation(shader->controlProgram, "ViewportSize");
+   shader->toleranceUniform = glGetUniformLocation(shader->controlProgram, "Tolerance");
+   shader->fixedLevelUniform = glGetUniformLocation(shader->controlProgram, "FixedLevel");
+}
 
-   // link shader program
-   shader->program = LinkProgram(shader->vertex, shader->fragment);
+// build a shader from the given stages, as one program or as a pipeline of
+// separable ones, returning true if successful; its uniforms can be looked
+// up once the library's programs are finished
+bool InitializeShaders(MyShaderLibrary *library, MyShader *shader, const MyStage *stages, int count)
+{
+   if (!library->separable)
+   {
+      shader->program = BuildProgram(library, stages, count);
+      shader->vertexProgram = shader->controlProgram = shader->program;
+      if (!shader->program)
+         return false;
+   }
+   else
+   {
+      glGenProgramPipelines(1, &shader->pipeline);
+      library->pipelines.push_back(shader->pipeline);
+      for (int i = 0; i < count; i++)
+      {
+         GLuint program = BuildProgram(library, &stages[i], 1);
+         if (!program)
+            return false;
+
+         MyPipelineStage use = { shader->pipeline, 0, program };
+         use.stage = stages[i].type == GL_VERTEX_SHADER ? GL_VERTEX_SHADER_BIT :
+            stages[i].type == GL_TESS_CONTROL_SHADER ? GL_TESS_CONTROL_SHADER_BIT :
+            stages[i].type == GL_TESS_EVALUATION_SHADER ? GL_TESS_EVALUATION_SHADER_BIT : GL_FRAGMENT_SHADER_BIT;
+         library->pendingStages.push_back(use);
+         if (stages[i].type == GL_VERTEX_SHADER)
+            shader->vertexProgram = program;
+         if (stages[i].type == GL_TESS_CONTROL_SHADER)
+            shader->controlProgram = program;
+      }
+      if (!shader->controlProgram)
+         shader->controlProgram = shader->vertexProgram;
+   }
 
    // check for OpenGL errors and return false if error occurred
    return !CheckGLErrors();
 }
 
-// deallocate shader-related objects
-void DestroyShaders(MyShader *shader)
+// build a shader with tessellation stages, returning true if successful
+bool InitializeShaders(MyShaderLibrary *library, MyShader *shader, const char *tcs, const char *tes,
+   const char *vertex = "vertex.glsl")
+{
+   const MyStage stages[] = {
+      { GL_VERTEX_SHADER, vertex },
+      { GL_TESS_CONTROL_SHADER, tcs },
+      { GL_TESS_EVALUATION_SHADER, tes },
+      { GL_FRAGMENT_SHADER, "fragment.glsl" }
+   };
+   return InitializeShaders(library, shader, stages, 4);
+}
+
+// build a shader without tessellation, returning true if successful
+bool InitializeShaders(MyShaderLibrary *library, MyShader *shader)
+{
+   const MyStage stages[] = {
+      { GL_VERTEX_SHADER, "vertex.glsl" },
+      { GL_FRAGMENT_SHADER, "fragment.glsl" }
+   };
+   return InitializeShaders(library, shader, stages, 2);
+}
+
+// deallocate every pipeline, program and shader object the library built
+void DestroyShaders(MyShaderLibrary *library)
 {
-   // unbind any shader programs and destroy shader objects
    glUseProgram(0);
-   glDeleteProgram(shader->program);
-   glDeleteShader(shader->vertex);
-   glDeleteShader(shader->fragment);
-   glDeleteShader(shader->TCS);
-   glDeleteShader(shader->TES);
+   if (!library->pipelines.empty())
+   {
+      glBindProgramPipeline(0);
+      glDeleteProgramPipelines(GLsizei(library->pipelines.size()), library->pipelines.data());
+   }
+   for (map<unsigned long long, GLuint>::iterator i = library->programs.begin(); i != library->programs.end(); ++i)
+      glDeleteProgram(i->second);
+   for (map<pair<GLenum, string>, GLuint>::iterator i = library->stages.begin(); i != library->stages.end(); ++i)
+      glDeleteShader(i->second);
+   library->pipelines.clear();
+   library->programs.clear();
+   library->stages.clear();
 }
 
 // --------------------------------------------------------------------------
 // Functions to set up OpenGL buffers for storing geometry data
 
+// Buffers and vertex arrays are created once and kept for the life of the
+// program. Their storage is used as a ring: each update is written after the
+// previous one, so the GPU can still be reading older contents, and the storage
+// is orphaned when the ring wraps. Capacity grows geometrically, so steady
+// state creates and allocates nothing.
 struct MyGeometry
 {
    // OpenGL names for array buffer objects, vertex array object
@@ -155,16 +567,64 @@ struct MyGeometry
    GLuint  vertexArray;
    GLsizei elementCount;
 
+   // indices into the current contents, if the geometry is drawn indexed;
+   // RESTART_INDEX separates strips. The buffer's allocated size is in bytes
+   GLuint  elementBuffer;
+   GLsizei indexCount;
+   GLsizeiptr indexCapacity;
+
+   // first vertex of the current contents, allocated size and ring write
+   // position, all measured in vertices
+   GLint   firstElement;
+   GLsizei capacity;
+   GLsizei head;
+
+   // vertex format, fixed when the buffers are created: positions are floats
+   // or shorts counting POSITION_QUANTUM units, and colours are RGBA8 per
+   // vertex or a single colour for every draw
+   bool    quantized;
+   bool    perVertexColour;
+   GLfloat colour[3];
+
    // initialize object names to zero (OpenGL reserved value)
-   MyGeometry() : vertexBuffer(0), colourBuffer(0), vertexArray(0), elementCount(0)
-   {}
+   MyGeometry() : vertexBuffer(0), colourBuffer(0), vertexArray(0), elementCount(0),
+      elementBuffer(0), indexCount(0), indexCapacity(0), firstElement(0), capacity(0), head(0), quantized(false), perVertexColour(true)
+   {
+      colour[0] = colour[1] = colour[2] = 1.0f;
+   }
 };
 
+// index that ends one line strip and starts the next
+static const GLushort RESTART_INDEX = 0xFFFF;
+
+// quantized positions are multiples of this, which keeps any glyph outline
+// (within 8 EM of its origin) to a 1/8192 EM rounding error
+static const GLfloat POSITION_QUANTUM = 1.0f / 4096.0f;
+
+// bytes each vertex takes in a geometry's position and colour buffers
+GLsizei PositionBytes(const MyGeometry *geometry)
+{
+   return geometry->quantized ? 2 * sizeof(GLshort) : 2 * sizeof(GLfloat);
+}
+
+GLsizei ColourBytes(const MyGeometry *geometry)
+{
+   return geometry->perVertexColour ? 4 * sizeof(GLubyte) : 0;
+}
+
+// number of GL objects created and buffer stores grown since startup
+static unsigned int glObjectsCreated_ = 0;
+static unsigned int glBufferAllocations_ = 0;
+
 void clearVectors()
 {
+   geometryChanged_ = true;
+   textRun_ = 0;
+
    // clear vertices
    pointVertices_.clear();
    lineVertices_.clear();
+   lineIndices_.clear();
    quadraticVertices_.clear();
    cubicVertices_.clear();
 
@@ -175,9 +635,24 @@ void clearVectors()
    cubicColours_.clear();
 }
 
+// draw the control polygon of each curve in pointVertices_ as a line strip
+// over its control points, each stored once
+void initControlPolygons(unsigned int degree)
+{
+   lineVertices_ = pointVertices_;
+   for (unsigned int i = 0; i < pointVertices_.size() / 2; i++)
+   {
+      if (i > 0 && i % (degree + 1) == 0)
+         lineIndices_.push_back(RESTART_INDEX);
+      lineIndices_.push_back(GLushort(i));
+   }
+}
+
 void initQuadraticControlPoints()
 {
    clearVectors();
+   translation_ = 0.0f;
+   scale_ = 1.0f;
 
    GLfloat scale = 2.5f;
 
@@ -189,18 +664,6 @@ void initQuadraticControlPoints()
    quadraticVertices_.push_back(0.0f / scale);
    quadraticVertices_.push_back(-1.0f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(1.0f / scale);
-   lineVertices_.push_back(1.0f / scale);
-
-   lineVertices_.push_back(2.0f / scale);
-   lineVertices_.push_back(-1.0f / scale);
-   lineVertices_.push_back(2.0f / scale);
-   lineVertices_.push_back(-1.0f / scale);
-
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(-1.0f / scale);
-
    //second set
    quadraticVertices_.push_back(0.0f / scale);
    quadraticVertices_.push_back(-1.0f / scale);
@@ -209,18 +672,6 @@ void initQuadraticControlPoints()
    quadraticVertices_.push_back(-1.0f / scale);
    quadraticVertices_.push_back(1.0f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(-1.0f / scale);
-
-   lineVertices_.push_back(-2.0f / scale);
-   lineVertices_.push_back(-1.0f / scale);
-   lineVertices_.push_back(-2.0f / scale);
-   lineVertices_.push_back(-1.0f / scale);
-
-   lineVertices_.push_back(-1.0f / scale);
-   lineVertices_.push_back(1.0f / scale);
-
    // third set
    quadraticVertices_.push_back(-1.0f / scale);
    quadraticVertices_.push_back(1.0f / scale);
@@ -229,18 +680,6 @@ void initQuadraticControlPoints()
    quadraticVertices_.push_back(1.0f / scale);
    quadraticVertices_.push_back(1.0f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(-1.0f / scale);
-   lineVertices_.push_back(1.0f / scale);
-
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(1.0f / scale);
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(1.0f / scale);
-
-   lineVertices_.push_back(1.0f / scale);
-   lineVertices_.push_back(1.0f / scale);
-
    //fourth set
    quadraticVertices_.push_back(1.2f / scale);
    quadraticVertices_.push_back(0.5f / scale);
@@ -249,20 +688,9 @@ void initQuadraticControlPoints()
    quadraticVertices_.push_back(1.3f / scale);
    quadraticVertices_.push_back(-0.4f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(1.2f / scale);
-   lineVertices_.push_back(0.5f / scale);
-
-   lineVertices_.push_back(2.5f / scale);
-   lineVertices_.push_back(1.0f / scale);
-   lineVertices_.push_back(2.5f / scale);
-   lineVertices_.push_back(1.0f / scale);
-
-   lineVertices_.push_back(1.3f / scale);
-   lineVertices_.push_back(-0.4f / scale);
-
-   // add control points to vector
+   // add control points to vector, and draw their control polygons
    pointVertices_ = quadraticVertices_;
+   initControlPolygons(2);
 
    // init quadratic colours
    for (unsigned int i = 0; i < quadraticVertices_.size() / 2; i++)
@@ -301,6 +729,8 @@ void initQuadraticControlPoints()
 void initCubicControlPoints()
 {
    clearVectors();
+   translation_ = 0.0f;
+   scale_ = 1.0f;
 
    GLfloat scale = 9.0f;
 
@@ -314,23 +744,6 @@ void initCubicControlPoints()
    cubicVertices_.push_back(9.0f / scale);
    cubicVertices_.push_back(1.0f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(1.0f / scale);
-   lineVertices_.push_back(1.0f / scale);
-
-   lineVertices_.push_back(4.0f / scale);
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(4.0f / scale);
-   lineVertices_.push_back(0.0f / scale);
-
-   lineVertices_.push_back(6.0f / scale);
-   lineVertices_.push_back(2.0f / scale);
-   lineVertices_.push_back(6.0f / scale);
-   lineVertices_.push_back(2.0f / scale);
-
-   lineVertices_.push_back(9.0f / scale);
-   lineVertices_.push_back(1.0f / scale);
-
    // second set
    cubicVertices_.push_back(8.0f / scale);
    cubicVertices_.push_back(2.0f / scale);
@@ -341,23 +754,6 @@ void initCubicControlPoints()
    cubicVertices_.push_back(8.0f / scale);
    cubicVertices_.push_back(4.0f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(8.0f / scale);
-   lineVertices_.push_back(2.0f / scale);
-
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(8.0f / scale);
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(8.0f / scale);
-
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(-2.0f / scale);
-   lineVertices_.push_back(0.0f / scale);
-   lineVertices_.push_back(-2.0f / scale);
-
-   lineVertices_.push_back(8.0f / scale);
-   lineVertices_.push_back(4.0f / scale);
-
    // third set
    cubicVertices_.push_back(5.0f / scale);
    cubicVertices_.push_back(3.0f / scale);
@@ -368,23 +764,6 @@ void initCubicControlPoints()
    cubicVertices_.push_back(5.0f / scale);
    cubicVertices_.push_back(2.0f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(5.0f / scale);
-   lineVertices_.push_back(3.0f / scale);
-
-   lineVertices_.push_back(3.0f / scale);
-   lineVertices_.push_back(2.0f / scale);
-   lineVertices_.push_back(3.0f / scale);
-   lineVertices_.push_back(2.0f / scale);
-
-   lineVertices_.push_back(3.0f / scale);
-   lineVertices_.push_back(3.0f / scale);
-   lineVertices_.push_back(3.0f / scale);
-   lineVertices_.push_back(3.0f / scale);
-
-   lineVertices_.push_back(5.0f / scale);
-   lineVertices_.push_back(2.0f / scale);
-
    // fourth set
    cubicVertices_.push_back(3.0f / scale);
    cubicVertices_.push_back(2.2f / scale);
@@ -395,23 +774,6 @@ void initCubicControlPoints()
    cubicVertices_.push_back(3.0f / scale);
    cubicVertices_.push_back(3.8f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(3.0f / scale);
-   lineVertices_.push_back(2.2f / scale);
-
-   lineVertices_.push_back(3.5f / scale);
-   lineVertices_.push_back(2.7f / scale);
-   lineVertices_.push_back(3.5f / scale);
-   lineVertices_.push_back(2.7f / scale);
-
-   lineVertices_.push_back(3.5f / scale);
-   lineVertices_.push_back(3.3f / scale);
-   lineVertices_.push_back(3.5f / scale);
-   lineVertices_.push_back(3.3f / scale);
-
-   lineVertices_.push_back(3.0f / scale);
-   lineVertices_.push_back(3.8f / scale);
-
    // fifth set
    cubicVertices_.push_back(2.8f / scale);
    cubicVertices_.push_back(3.5f / scale);
@@ -422,25 +784,9 @@ void initCubicControlPoints()
    cubicVertices_.push_back(2.8f / scale);
    cubicVertices_.push_back(3.5f / scale);
 
-   // line equivalent
-   lineVertices_.push_back(2.8f / scale);
-   lineVertices_.push_back(3.5f / scale);
-
-   lineVertices_.push_back(2.4f / scale);
-   lineVertices_.push_back(3.8f / scale);
-   lineVertices_.push_back(2.4f / scale);
-   lineVertices_.push_back(3.8f / scale);
-
-   lineVertices_.push_back(2.4f / scale);
-   lineVertices_.push_back(3.2f / scale);
-   lineVertices_.push_back(2.4f / scale);
-   lineVertices_.push_back(3.2f / scale);
-
-   lineVertices_.push_back(2.8f / scale);
-   lineVertices_.push_back(3.5f / scale);
-
-   // add control points to vector
+   // add control points to vector, and draw their control polygons
    pointVertices_ = cubicVertices_;
+   initControlPolygons(3);
 
    // init curve colours
    for (unsigned int i = 0; i < cubicVertices_.size() / 2; i++)
@@ -476,172 +822,1628 @@ void initCubicControlPoints()
    }
 }
 
-void initFont(GlyphExtractor& extractor, string words, GLfloat offset)
+// lays out a string to be drawn in EM space, returning its advance width; the
+// renderer draws it from glyph outlines uploaded once per font, and placement
+// on screen is left to the view transform, so scrolling does not require
+// rebuilding anything
+GLfloat initFont(TextLayout& layout, string words)
+{
+   PROFILE_SCOPE("initFont");
+   clearVectors();
+
+   // positions come from the memoized layout, which includes kerning
+   textLayout_ = &layout;
+   textRun_ = &layout.Layout(words);
+   return textRun_->advance;
+}
+
+// shows the marquee file from its start in the current font; the main loop
+// moves it along, and the glyphs around the view are streamed in as it does
+void initMarquee(TextLayout& layout, TextStream& stream)
 {
+   PROFILE_SCOPE("initMarquee");
    clearVectors();
 
-   GLfloat scale = 0.90f;
+   stream.Rewind();
+   textLayout_ = &layout;
+   textRun_ = &stream.Run();
+}
 
-   // Go through each character
-   for (unsigned int i = 0; i < words.size(); i++)
-   {
-      // Load a character
-      MyGlyph glyph = extractor.ExtractGlyph(words[i]);
+// moves the view along streamed text to the given offset, which places it
+// like offset_ places a string, laying out the glyphs about to come into view
+// and dropping those well past it; a view width is prefetched at a time.
+// Returns true if the glyphs held changed.
+bool ScrollMarquee(TextStream& stream, double offset)
+{
+   PROFILE_SCOPE("ScrollMarquee");
+   double half = 1.0 / scale_;
+   bool changed = stream.Cover(-half - offset, half - offset, 2.0 * half);
+
+   // the run is placed relative to its origin, which keeps the translation
+   // small however far along the file the view is
+   translation_ = GLfloat(offset + stream.Origin());
+   return changed;
+}
 
-      // load the contours
-      for each(MyContour contour in glyph.contours)
+// advances scrolling text by the given number of steps, and places the view
+// the given fraction of the way into the next; the string starts over at
+// minOffset_, and the marquee file once all of it has gone by
+void ScrollText(int steps, double fraction)
+{
+   PROFILE_SCOPE("ScrollText");
+   double speed = SCROLL_STEP * multiplier_;
+   if (textRun_ == &marquee_.Run())
+   {
+      for (int i = 0; i < steps; i++)
       {
-         for each(MySegment seg in contour)
+         marqueeOffset_ -= speed;
+         if (marquee_.Finished())
          {
-            // linear 
-            if (seg.degree == 1)
-            {
-               for (int j = 0; j < 2; j++)
-               {
-                  lineVertices_.push_back((seg.x[j] + offset) * scale);
-                  lineVertices_.push_back(seg.y[j] * scale);
-               }
-            }
-            // quadratic
-            else if (seg.degree == 2)
-            {
-               for (int j = 0; j < 3; j++)
-               {
-                  quadraticVertices_.push_back((seg.x[j] + offset) * scale);
-                  quadraticVertices_.push_back(seg.y[j] * scale);
-               }
-            }
-            // cubic
-            else if (seg.degree == 3)
-            {
-               for (int j = 0; j < 4; j++)
-               {
-                  cubicVertices_.push_back((seg.x[j] + offset) * scale);
-                  cubicVertices_.push_back(seg.y[j] * scale);
-               }
-            }
+            const GlyphExtractor &extractor = fontLoader_.Front().extractor;
+            cout << "Marquee: " << marquee_.CharactersLaidOut() << " characters shown; glyph cache: "
+               << extractor.CacheHits() << " hits, " << extractor.CacheMisses() << " misses" << endl;
+            marquee_.Rewind();
+            marqueeOffset_ = 1.1;
          }
       }
-      offset += glyph.advance;
+
+      // only the glyphs around the view are held, and the text follows
+      // them when they change
+      if (ScrollMarquee(marquee_, marqueeOffset_ - fraction * speed))
+         textChanged_ = true;
+      return;
    }
 
-   // init line colours
-   for (unsigned int j = 0; j < lineVertices_.size() / 2; j++)
+   for (int i = 0; i < steps; i++)
    {
-      lineColours_.push_back(1.0f);
-      lineColours_.push_back(0.0f);
-      lineColours_.push_back(0.0f);
+      offset_ -= GLfloat(speed);
+      if (offset_ <= minOffset_)
+      {
+         offset_ = 1.1f;
+
+         // report glyph cache activity once per scroll cycle; in steady state
+         // every lookup should be a hit and FreeType should not be touched
+         const FontSlot &slot = fontLoader_.Front();
+         cout << "Glyph cache: " << slot.extractor.CacheHits() << " hits, "
+            << slot.extractor.CacheMisses() << " misses; layout: " << slot.layout.RunHits()
+            << " runs reused, " << slot.layout.RunMisses() << " laid out" << endl;
+      }
    }
 
-   // init quadratic colours
-   for (unsigned int j = 0; j < quadraticVertices_.size() / 2; j++)
+   // the string itself is retained on the GPU; only the view moves
+   translation_ = GLfloat(offset_ - fraction * speed);
+}
+
+// asks for a font switch: the font is loaded in the background, and the
+// switch is shown by ShowLoadedText once it has
+void SwitchText(const string &font, const string &text, const MyTextSwitch &settings)
+{
+   switchTiming_.tracking = true;
+   switchTiming_.requested = chrono::steady_clock::now();
+   switchTiming_.frames.clear();
+
+   textSwitch_ = settings;
+   fontLoader_.Request(font, text);
+}
+
+// adds a frame's work to the timing of a font switch under way, reporting
+// the frames it took once the switch has been shown
+void TimeSwitchFrame(double seconds, bool shown)
+{
+   MySwitchTiming &timing = switchTiming_;
+   if (!timing.tracking)
+      return;
+   timing.frames.push_back(seconds);
+   if (!shown)
+      return;
+
+   const FontSlot &slot = fontLoader_.Front();
+   double waited = chrono::duration<double>(chrono::steady_clock::now() - timing.requested).count();
+   cout << "Font switch: " << slot.filename << " loaded in " << slot.seconds * 1000.0
+      << " ms in the background, shown " << waited * 1000.0 << " ms and " << timing.frames.size() - 1
+      << " frames after the key; slowest frame " << *max_element(timing.frames.begin(), timing.frames.end()) * 1000.0
+      << " ms of work, the frame showing it " << seconds * 1000.0 << " ms" << endl;
+   timing.tracking = false;
+}
+
+// ends a stage of starting up, timed from the end of the one before
+void MarkStartup(const char *stage)
+{
+   chrono::steady_clock::time_point now = chrono::steady_clock::now();
+   startup_.stages.push_back(make_pair(string(stage),
+      chrono::duration<double, milli>(now - startup_.last).count()));
+   startup_.last = now;
+}
+
+// reports the time to the first frame, once, with the stages it took and how
+// the font preload is doing if fonts are preloaded
+void ReportStartup(bool fonts)
+{
+   if (startup_.reported)
+      return;
+   startup_.reported = true;
+
+   cout << "Startup: first frame after "
+      << chrono::duration<double, milli>(startup_.last - startup_.start).count() << " ms (";
+   for (size_t i = 0; i < startup_.stages.size(); i++)
+      cout << (i ? ", " : "") << startup_.stages[i].first << " " << startup_.stages[i].second << " ms";
+   cout << ")";
+   if (fonts && fontLoader_.Preloading())
+      cout << "; fonts still preloading";
+   else if (fonts && fontLoader_.PreloadCancelled())
+      cout << "; font preload cut short after " << fontLoader_.PreloadSeconds() * 1000.0 << " ms";
+   else if (fonts)
+      cout << "; fonts preloaded in " << fontLoader_.PreloadSeconds() * 1000.0 << " ms";
+   cout << endl;
+}
+
+// writes the profiled scopes as a Chrome trace, with a summary of those since
+// the last one
+void WriteProfile(const string &filename)
+{
+   if (!PROFILER_ENABLED)
+      cout << "Profiling was not compiled in (PROFILER_ENABLED is 0)" << endl;
+   else if (Profiler::WriteTrace(filename))
+      cout << "Wrote profile trace " << filename << endl;
+   else
+      cout << "ERROR: could not write " << filename << endl;
+   Profiler::Summarize(cout);
+}
+
+// shows the text of the latest font switch if its font has finished loading
+// since the last call, returning true if so
+bool ShowLoadedText()
+{
+   if (!fontLoader_.Swap())
+      return false;
+   PROFILE_SCOPE("ShowLoadedText");
+
+   // the slot swapped out may be loaded into again from here on, so
+   // nothing shown may come from it
+   FontSlot &slot = fontLoader_.Front();
+   needsRedraw_ = true;
+   if (!slot.run)
    {
-      quadraticColours_.push_back(1.0f);
-      quadraticColours_.push_back(0.0f);
-      quadraticColours_.push_back(0.0f);
+      clearVectors();
+      textLayout_ = 0;
+      textRun_ = 0;
+      isScrolling_ = false;
+      return true;
    }
 
-   // init cubic colours
-   for (unsigned int j = 0; j < cubicVertices_.size() / 2; j++)
+   // build the string once, or start streaming the marquee file; the main
+   // loop scrolls either with the view transform
+   scale_ = 0.90f;
+   isScrolling_ = textSwitch_.scrolling;
+   minOffset_ = textSwitch_.minOffset;
+   if (textSwitch_.marquee)
    {
-      cubicColours_.push_back(1.0f);
-      cubicColours_.push_back(0.0f);
-      cubicColours_.push_back(0.0f);
+      marquee_.UseLayout(slot.layout);
+      initMarquee(slot.layout, marquee_);
+      marqueeOffset_ = 1.1;
+      ScrollMarquee(marquee_, marqueeOffset_);
+   }
+   else
+   {
+      initFont(slot.layout, slot.text);
+      translation_ = textSwitch_.scrolling ? offset_ : textSwitch_.translation;
    }
+   return true;
 }
 
-// create buffers and fill with geometry data, returning true if successful
-bool InitializeGeometry(MyGeometry *geometry, vector<GLfloat>& vertices, vector<GLfloat>& colours)
+// create the buffers and vertex array object for a geometry
+void CreateGeometry(MyGeometry *geometry)
 {
-   geometry->elementCount = vertices.size() / 2;
-
    // these vertex attribute indices correspond to those specified for the
    // input variables in the vertex shader
    const GLuint VERTEX_INDEX = 0;
    const GLuint COLOUR_INDEX = 1;
 
-   // create an array buffer object for storing our vertices
+   // create array buffer objects for storing our vertices and colours
    glGenBuffers(1, &geometry->vertexBuffer);
-   glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-   glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
-
-   // create another one for storing our colours
-   glGenBuffers(1, &geometry->colourBuffer);
-   glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
-   glBufferData(GL_ARRAY_BUFFER, colours.size()*sizeof(GLfloat), colours.data(), GL_STATIC_DRAW);
+   if (geometry->perVertexColour)
+      glGenBuffers(1, &geometry->colourBuffer);
 
    // create a vertex array object encapsulating all our vertex attributes
    glGenVertexArrays(1, &geometry->vertexArray);
    glBindVertexArray(geometry->vertexArray);
+   glObjectsCreated_ += geometry->perVertexColour ? 3 : 2;
 
-   // associate the position array with the vertex array object
+   // associate the position array with the vertex array object; shorts are
+   // converted to float as they are, and scaled in the vertex shader
    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-   glVertexAttribPointer(VERTEX_INDEX, 2, GL_FLOAT, GL_FALSE, 0, 0);
+   glVertexAttribPointer(VERTEX_INDEX, 2, geometry->quantized ? GL_SHORT : GL_FLOAT, GL_FALSE, 0, 0);
    glEnableVertexAttribArray(VERTEX_INDEX);
 
-   // associate the colour array with the vertex array object
-   glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
-   glVertexAttribPointer(COLOUR_INDEX, 3, GL_FLOAT, GL_FALSE, 0, 0);
-   glEnableVertexAttribArray(COLOUR_INDEX);
+   // associate the colour array with the vertex array object; without one,
+   // the attribute reads the value set for each draw
+   if (geometry->perVertexColour)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
+      glVertexAttribPointer(COLOUR_INDEX, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, 0);
+      glEnableVertexAttribArray(COLOUR_INDEX);
+   }
 
    // unbind our buffers, resetting to default state
    glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindVertexArray(0);
+}
+
+// (re)allocate storage for the given number of vertices, dropping the old
+// contents; when the size is unchanged this orphans the store in the driver
+void AllocateGeometry(MyGeometry *geometry, GLsizei capacity)
+{
+   glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
+   glBufferData(GL_ARRAY_BUFFER, capacity * PositionBytes(geometry), 0, GL_DYNAMIC_DRAW);
+   if (geometry->perVertexColour)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
+      glBufferData(GL_ARRAY_BUFFER, capacity * ColourBytes(geometry), 0, GL_DYNAMIC_DRAW);
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   if (capacity != geometry->capacity) ++glBufferAllocations_;
+   geometry->capacity = capacity;
+   geometry->head = 0;
+}
+
+// write data into the currently bound array buffer without synchronizing
+// with the GPU; the caller guarantees the range is not in use
+void StreamBufferRange(GLintptr offset, GLsizeiptr size, const void *data)
+{
+   void *mapped = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT |
+      GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+   if (mapped) {
+      memcpy(mapped, data, size);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+   }
+   else {
+      glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+   }
+}
+
+// write data to the start of the buffer bound to a target, growing its store
+// geometrically only when the data does not fit, as the vertex rings do, so
+// that updates of a similar size allocate nothing; capacity is in bytes
+void FillBuffer(GLenum target, GLsizeiptr &capacity, GLsizeiptr size, const void *data)
+{
+   if (size > capacity)
+   {
+      capacity = max(size, max(2 * capacity, GLsizeiptr(1024)));
+      glBufferData(target, capacity, 0, GL_DYNAMIC_DRAW);
+      ++glBufferAllocations_;
+   }
+   if (size > 0)
+      glBufferSubData(target, 0, size, data);
+}
+
+// fill the geometry's buffers with new data, converted to its vertex format
+// (colours are ignored if it has a single colour), and with indices into
+// those vertices if any are given, creating them on first use, returning
+// true if successful
+bool UpdateGeometry(MyGeometry *geometry, const vector<GLfloat>& vertices, const vector<GLfloat>& colours,
+   const vector<GLushort>& indices)
+{
+   PROFILE_SCOPE("UpdateGeometry");
+   static vector<GLshort> shorts;
+   static vector<GLubyte> bytes;
+
+   GLsizei count = vertices.size() / 2;
+   geometry->elementCount = count;
+   geometry->indexCount = 0;
+   if (count == 0)
+      return true;
+
+   if (!geometry->vertexArray)
+      CreateGeometry(geometry);
+
+   // grow geometrically if the data does not fit at all, otherwise orphan the
+   // store and restart the ring when the data does not fit after the head
+   if (count > geometry->capacity)
+      AllocateGeometry(geometry, max(count, max(2 * geometry->capacity, 1024)));
+   else if (geometry->head + count > geometry->capacity)
+      AllocateGeometry(geometry, geometry->capacity);
+
+   // stream the data into the free region after the ring head
+   const void *positions = vertices.data();
+   if (geometry->quantized)
+   {
+      shorts.resize(vertices.size());
+      for (size_t i = 0; i < vertices.size(); i++)
+         shorts[i] = GLshort(max(-32767.0f, min(32767.0f, floor(vertices[i] / POSITION_QUANTUM + 0.5f))));
+      positions = shorts.data();
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
+   StreamBufferRange(geometry->head * PositionBytes(geometry), count * PositionBytes(geometry), positions);
+   if (geometry->perVertexColour)
+   {
+      bytes.resize(4 * count);
+      for (GLsizei i = 0; i < count; i++)
+      {
+         for (int c = 0; c < 3; c++)
+            bytes[4 * i + c] = GLubyte(max(0.0f, min(1.0f, colours[3 * i + c])) * 255.0f + 0.5f);
+         bytes[4 * i + 3] = 255;
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
+      StreamBufferRange(geometry->head * ColourBytes(geometry), count * ColourBytes(geometry), bytes.data());
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   // indices count from the first vertex of the contents, which is passed
+   // as the base vertex when drawing; the buffer belongs to the vertex array
+   if (!indices.empty())
+   {
+      glBindVertexArray(geometry->vertexArray);
+      if (!geometry->elementBuffer)
+      {
+         glGenBuffers(1, &geometry->elementBuffer);
+         glObjectsCreated_++;
+      }
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->elementBuffer);
+      FillBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->indexCapacity, indices.size() * sizeof(GLushort), indices.data());
+      glBindVertexArray(0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+      geometry->indexCount = GLsizei(indices.size());
+   }
+
+   geometry->firstElement = geometry->head;
+   geometry->head += count;
 
    // check for OpenGL errors and return false if error occurred
    return !CheckGLErrors();
 }
 
+bool UpdateGeometry(MyGeometry *geometry, const vector<GLfloat>& vertices, const vector<GLfloat>& colours)
+{
+   static const vector<GLushort> none;
+   return UpdateGeometry(geometry, vertices, colours, none);
+}
+
 // deallocate geometry-related objects
 void DestroyGeometry(MyGeometry *geometry)
 {
+   PROFILE_SCOPE("DestroyGeometry");
    // unbind and destroy our vertex array object and associated buffers
    glBindVertexArray(0);
    glDeleteVertexArrays(1, &geometry->vertexArray);
    glDeleteBuffers(1, &geometry->vertexBuffer);
    glDeleteBuffers(1, &geometry->colourBuffer);
+   glDeleteBuffers(1, &geometry->elementBuffer);
+
+   // reset names so the geometry can safely be destroyed or rebuilt again
+   geometry->vertexArray = 0;
+   geometry->vertexBuffer = 0;
+   geometry->colourBuffer = 0;
+   geometry->elementBuffer = 0;
+   geometry->elementCount = 0;
+   geometry->indexCount = 0;
+   geometry->indexCapacity = 0;
+   geometry->capacity = 0;
+   geometry->head = 0;
 }
 
 // --------------------------------------------------------------------------
 // Rendering function that draws our scene to the frame buffer
 
+// bind a shader program or pipeline and set the view and tessellation
+// uniforms; a pipeline is left with its vertex program active, which is the
+// one uniforms set afterwards go to
+void UseShader(MyShader *shader)
+{
+   if (shader->pipeline) {
+      glBindProgramPipeline(shader->pipeline);
+      glActiveShaderProgram(shader->pipeline, shader->controlProgram);
+   }
+   else
+      glUseProgram(shader->program);
+   glUniform2f(shader->viewportUniform, GLfloat(viewportWidth_), GLfloat(viewportHeight_));
+   glUniform1f(shader->toleranceUniform, 0.25f);
+   glUniform1i(shader->fixedLevelUniform, adaptiveTessellation_ ? 0 : 30);
+
+   if (shader->pipeline)
+      glActiveShaderProgram(shader->pipeline, shader->vertexProgram);
+   glUniform1f(shader->translationUniform, translation_);
+   glUniform1f(shader->scaleUniform, scale_);
+}
+
+// unbind whichever shader program or pipeline a shader used
+void ResetShader(MyShader *shader)
+{
+   if (shader->pipeline)
+      glBindProgramPipeline(0);
+   else
+      glUseProgram(0);
+}
+
+// bind a geometry's vertex array and set what completes its vertex format
+// for the shader: the scale of its positions and, if it has no colour per
+// vertex, the value its colour attribute reads
+void BindGeometry(MyGeometry *geometry, MyShader *shader)
+{
+   const GLuint COLOUR_INDEX = 1;
+
+   glUniform1f(shader->positionScaleUniform, geometry->quantized ? POSITION_QUANTUM : 1.0f);
+   if (!geometry->perVertexColour)
+      glVertexAttrib3fv(COLOUR_INDEX, geometry->colour);
+   glBindVertexArray(geometry->vertexArray);
+}
+
 void RenderScene(MyGeometry *geometry, MyShader *shader, int renderMode)
 {
+   PROFILE_SCOPE("RenderScene");
    // bind our shader program and the vertex array object containing our
    // scene geometry, then tell OpenGL to draw our geometry
-   glUseProgram(shader->program);
-   glBindVertexArray(geometry->vertexArray);
-   glDrawArrays(renderMode, 0, geometry->elementCount);
+   UseShader(shader);
+   BindGeometry(geometry, shader);
+   if (geometry->indexCount)
+      glDrawElementsBaseVertex(renderMode, geometry->indexCount, GL_UNSIGNED_SHORT, 0, geometry->firstElement);
+   else
+      glDrawArrays(renderMode, geometry->firstElement, geometry->elementCount);
 
    // reset state to default (no shader or geometry bound)
    glBindVertexArray(0);
-   glUseProgram(0);
+   ResetShader(shader);
 
    // check for an report any OpenGL errors
    CheckGLErrors();
 }
 
 // --------------------------------------------------------------------------
-// GLFW callback functions
+// Functions to draw text by instancing glyph outlines
+
+// draw entry points from after OpenGL 4.1, loaded by hand when the context
+// provides them; text falls back to plain instanced draws without them
+typedef void (APIENTRYP MyMultiDrawElementsIndirectProc)(GLenum mode, GLenum type,
+   const void *indirect, GLsizei drawCount, GLsizei stride);
+typedef void (APIENTRYP MyDrawElementsInstancedBaseVertexBaseInstanceProc)(GLenum mode,
+   GLsizei count, GLenum type, const void *indices, GLsizei instanceCount, GLint baseVertex,
+   GLuint baseInstance);
+static MyMultiDrawElementsIndirectProc multiDrawElementsIndirect_ = 0;
+static MyDrawElementsInstancedBaseVertexBaseInstanceProc drawElementsInstancedBaseVertexBaseInstance_ = 0;
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
 
-// reports GLFW errors
-void ErrorCallback(int error, const char* description)
+// look up the optional draw functions; drivers may hand out pointers for
+// anything they know of, so the context version decides what is used
+void LoadDrawFunctions(GLADloadproc load)
 {
-   cout << "GLFW ERROR " << error << ":" << endl;
-   cout << description << endl;
+   GLint major = 0, minor = 0;
+   glGetIntegerv(GL_MAJOR_VERSION, &major);
+   glGetIntegerv(GL_MINOR_VERSION, &minor);
+   int version = 10 * major + minor;
+
+   multiDrawElementsIndirect_ = version >= 43 ? reinterpret_cast<MyMultiDrawElementsIndirectProc>(
+      load("glMultiDrawElementsIndirect")) : 0;
+   drawElementsInstancedBaseVertexBaseInstance_ = version >= 42 ?
+      reinterpret_cast<MyDrawElementsInstancedBaseVertexBaseInstanceProc>(
+      load("glDrawElementsInstancedBaseVertexBaseInstance")) : 0;
+
+   cout << "Text drawn with " << (multiDrawElementsIndirect_ ? "one indirect multi-draw per primitive class" :
+      drawElementsInstancedBaseVertexBaseInstance_ ? "a base instance draw per glyph" : "an instanced draw per glyph") << endl;
 }
 
-// handles keyboard input events
-void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+// text outlines are split by primitive, as each needs its own shader
+enum { LINE_CLASS = 0, QUADRATIC_CLASS, CUBIC_CLASS, CLASS_COUNT };
+
+// where a glyph's points are among its font's vertices, and where its
+// indices are in each primitive class; indices count from the glyph's first
+// point, so they stay small. A glyph with more points than 16-bit indices
+// reach is split into pieces, each with a base vertex of its own; next is
+// the glyph's following piece in its font's overflow, or -1
+struct MyGlyphRange
 {
-   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-      glfwSetWindowShouldClose(window, GL_TRUE);
-   else if (key == GLFW_KEY_B && action == GLFW_PRESS)
+   GLint    baseVertex;
+   GLint    first[CLASS_COUNT];
+   GLsizei  count[CLASS_COUNT];
+   GLint    next;
+};
+
+// the outline of every glyph a font has shown so far, uploaded once and then
+// drawn as an instance wherever the glyph appears. Points shared by adjacent
+// segments are stored once: lines are drawn as strips and curves as indexed
+// patches, with the indices of each class one after another in the same
+// element buffer.
+struct MyFontGeometry
+{
+   MyGeometry                       outline;
+   vector<GLfloat>                  vertices;
+   vector<GLushort>                 indices[CLASS_COUNT];
+   GLint                            classFirst[CLASS_COUNT];
+   unordered_map<int, MyGlyphRange> glyphs;
+   vector<MyGlyphRange>             overflow;
+
+   // curves are flattened into lines to this tolerance in EM units, or left
+   // to the tessellation shaders when it is zero; unflattened outlines may
+   // be elevated to cubics only
+   GLfloat                          tolerance;
+   bool                             elevated;
+
+   // pulled outlines keep the glyphs as extracted instead, in buffer
+   // textures of points, segments' first points and segment degrees that
+   // the vertex shader reads; the outline then holds only a run of
+   // consecutive indices, which with each glyph's base vertex give
+   // gl_VertexID
+   bool                             pulled;
+   vector<GLfloat>                  points;
+   vector<GLuint>                   segments;
+   vector<GLubyte>                  degrees;
+   GLuint                           pullBuffers[3];
+   GLsizeiptr                       pullCapacities[3];
+   GLuint                           pullTextures[3];
+
+   MyFontGeometry() : tolerance(0.0f), elevated(false), pulled(false)
    {
-      needsRedraw_ = true;
-      isScrolling_ = false;
+      fill(classFirst, classFirst + CLASS_COUNT, 0);
+      fill(pullBuffers, pullBuffers + 3, 0);
+      fill(pullCapacities, pullCapacities + 3, 0);
+      fill(pullTextures, pullTextures + 3, 0);
+   }
+};
 
-      isQuadratic_ = !isQuadratic_;
+// an indirect draw, laid out as glMultiDrawElementsIndirect reads it
+struct MyDrawCommand
+{
+   GLuint   count;
+   GLuint   instanceCount;
+   GLuint   firstIndex;
+   GLint    baseVertex;
+   GLuint   baseInstance;
+};
+
+// Everything needed to draw the current scene into whichever framebuffer is
+// bound, shared by the window and the headless renderer
+struct MyRenderer
+{
+   MyShaderLibrary   shaders;
+   MyShader    lineShader;
+   MyShader    quadraticShader;
+   MyShader    cubicShader;
+   MyShader    pulledShader;
+
+   MyGeometry  pointGeometry;
+   MyGeometry  lineGeometry;
+   MyGeometry  quadraticGeometry;
+   MyGeometry  cubicGeometry;
+   MyGeometry  flatGeometry;
+
+   // counts the primitives drawn for curves, when reporting is enabled
+   GLuint      primitivesQuery;
+   GLuint      lastPrimitives;
+
+   // glyph outlines of every font text has been shown in, by extractor
+   // serial and font handle (handles are only unique within an extractor),
+   // and the instances and draws for the glyphs of the current text run that
+   // are in view, by class
+   map<pair<unsigned long, FontHandle>, MyFontGeometry> fonts;
+   MyFontGeometry                  *textFont;
+   vector<size_t>                   visibleGlyphs;
+   GLuint                           instanceBuffer;
+   GLuint                           commandBuffer;
+   GLsizeiptr                       instanceCapacity;
+   GLsizeiptr                       commandCapacity;
+   vector<MyDrawCommand>            commands;
+   size_t                           classCommands[CLASS_COUNT + 1];
+
+   MyRenderer() : primitivesQuery(0), lastPrimitives(0), textFont(0),
+      instanceBuffer(0), commandBuffer(0), instanceCapacity(0), commandCapacity(0)
+   {
+      fill(classCommands, classCommands + CLASS_COUNT + 1, 0);
+   }
+};
+
+// write the control points of the cubic that exactly traces a line,
+// quadratic or cubic segment, given as x,y pairs
+void ElevateToCubic(const GLfloat *points, unsigned int degree, GLfloat *cubic)
+{
+   for (int i = 0; i < 2; i++)
+   {
+      GLfloat p0 = points[i], p1 = points[2 + i];
+      if (degree == 1)
+      {
+         // evenly spaced along the line
+         cubic[i] = p0;
+         cubic[2 + i] = p0 + (p1 - p0) / 3.0f;
+         cubic[4 + i] = p0 + 2.0f * (p1 - p0) / 3.0f;
+         cubic[6 + i] = p1;
+      }
+      else if (degree == 2)
+      {
+         // two thirds of the way from each end to the quadratic's control
+         GLfloat p2 = points[4 + i];
+         cubic[i] = p0;
+         cubic[2 + i] = p0 + 2.0f * (p1 - p0) / 3.0f;
+         cubic[4 + i] = p2 + 2.0f * (p1 - p2) / 3.0f;
+         cubic[6 + i] = p2;
+      }
+      else
+      {
+         for (int j = 0; j < 4; j++)
+            cubic[2 * j + i] = points[2 * j + i];
+      }
+   }
+}
+
+// start a glyph piece at its font's next vertex and indices
+MyGlyphRange OpenGlyphPiece(const MyFontGeometry *font)
+{
+   MyGlyphRange piece;
+   piece.baseVertex = GLint(font->vertices.size() / 2);
+   for (int c = 0; c < CLASS_COUNT; c++)
+   {
+      piece.first[c] = GLint(font->indices[c].size());
+      piece.count[c] = 0;
+   }
+   piece.next = -1;
+   return piece;
+}
+
+// end a glyph's last piece with the indices added since it started
+void CloseGlyphPiece(const MyFontGeometry *font, MyGlyphRange &piece)
+{
+   for (int c = 0; c < CLASS_COUNT; c++)
+      piece.count[c] = GLsizei(font->indices[c].size()) - piece.first[c];
+}
+
+// file a glyph's pieces under its character: the first in the font's
+// glyphs and the rest in its overflow, each linked to the next
+void AddGlyphPieces(MyFontGeometry *font, int character, vector<MyGlyphRange> &pieces)
+{
+   size_t overflow = font->overflow.size();
+   for (size_t i = 0; i + 1 < pieces.size(); i++)
+      pieces[i].next = GLint(overflow + i);
+   font->glyphs[character] = pieces[0];
+   font->overflow.insert(font->overflow.end(), pieces.begin() + 1, pieces.end());
+}
+
+// add a line between two points to the strips after start, continuing the
+// last strip if it ended where this line starts
+void AddStripLine(vector<GLushort> &indices, size_t start, GLushort from, GLushort to)
+{
+   if (indices.size() == start || indices.back() != from)
+   {
+      if (indices.size() > start)
+         indices.push_back(RESTART_INDEX);
+      indices.push_back(from);
+   }
+   indices.push_back(to);
+}
+
+// append a glyph's outline to its font's vertices and indices, remembering
+// where; RESTART_INDEX is reserved, so a piece holds at most that many
+// vertices, and a glyph that needs more starts another piece
+void AddFontGlyph(MyFontGeometry *font, int character, const MyPackedGlyph &glyph)
+{
+   static vector<MyGlyphRange> pieces;
+   pieces.clear();
+   pieces.push_back(OpenGlyphPiece(font));
+   vector<GLushort> &lines = font->indices[LINE_CLASS];
+
+   if (font->pulled)
+   {
+      // the glyph is copied as it is, but for making segments refer to the
+      // font's points; each segment is drawn as four consecutive vertices
+      GLuint base = GLuint(font->points.size() / 2);
+      GLint firstSegment = GLint(font->segments.size());
+      font->points.insert(font->points.end(), glyph.points, glyph.points + 2 * glyph.pointCount);
+      for (unsigned int s = 0; s < glyph.segmentCount; s++)
+         font->segments.push_back(base + glyph.segments[s]);
+      font->degrees.insert(font->degrees.end(), glyph.degrees, glyph.degrees + glyph.segmentCount);
+
+      // every piece counts through the same indices from zero
+      const unsigned int pieceSegments = RESTART_INDEX / 4;
+      vector<GLushort> &sequence = font->indices[CUBIC_CLASS];
+      while (sequence.size() < 4 * min(glyph.segmentCount, pieceSegments))
+         sequence.push_back(GLushort(sequence.size()));
+      for (unsigned int s = 0; s == 0 || s < glyph.segmentCount; s += pieceSegments)
+      {
+         if (s > 0)
+            pieces.push_back(pieces[0]);
+         MyGlyphRange &piece = pieces.back();
+         piece.baseVertex = GLint(4 * (firstSegment + s));
+         for (int c = 0; c < CLASS_COUNT; c++)
+            piece.first[c] = 0;
+         piece.count[CUBIC_CLASS] = GLsizei(4 * min(glyph.segmentCount - s, pieceSegments));
+      }
+      AddGlyphPieces(font, character, pieces);
+      return;
+   }
+
+   if (font->tolerance > 0.0f)
+   {
+      // everything becomes lines, which follow on from one another along
+      // each curve
+      static vector<GLfloat> flat;
+      flat.clear();
+      flattener_.AddGlyph(glyph, 0.0f, 0.0f);
+      flattener_.Flatten(font->tolerance, flat);
+
+      GLuint count = 0;
+      for (size_t i = 0; i < flat.size(); i += 4)
+      {
+         if (count + 2 > RESTART_INDEX)
+         {
+            CloseGlyphPiece(font, pieces.back());
+            pieces.push_back(OpenGlyphPiece(font));
+            count = 0;
+         }
+
+         // reuse the previous point when this line starts there
+         bool joined = count > 0 && flat[i] == font->vertices[font->vertices.size() - 2] &&
+            flat[i + 1] == font->vertices.back();
+         if (!joined)
+         {
+            font->vertices.insert(font->vertices.end(), flat.begin() + i, flat.begin() + i + 2);
+            count++;
+         }
+         font->vertices.insert(font->vertices.end(), flat.begin() + i + 2, flat.begin() + i + 4);
+         count++;
+         AddStripLine(lines, pieces.back().first[LINE_CLASS], GLushort(count - 2), GLushort(count - 1));
+      }
+   }
+   else
+   {
+      // segments share the glyph's points, unless there are too many to
+      // index, when each segment brings its own
+      bool shared = glyph.pointCount <= RESTART_INDEX;
+      GLuint count = 0;
+      if (shared)
+      {
+         font->vertices.insert(font->vertices.end(), glyph.points, glyph.points + 2 * glyph.pointCount);
+         count = glyph.pointCount;
+      }
+
+      for (unsigned int s = 0; s < glyph.segmentCount; s++)
+      {
+         // control points of this segment, shared with its neighbours
+         GLuint first = glyph.segments[s];
+         unsigned int degree = glyph.degrees[s];
+         if (degree < 1 || degree > 3)
+            continue;
+
+         // elevated curves have their ends shared and new inner controls
+         const GLfloat *controls = glyph.points + 2 * first;
+         GLfloat cubic[8];
+         unsigned int controlCount = degree + 1;
+         if (font->elevated)
+         {
+            ElevateToCubic(controls, degree, cubic);
+            controls = cubic;
+            controlCount = 4;
+         }
+
+         GLuint added = !shared ? controlCount : font->elevated && degree < 3 ? 2 : 0;
+         if (count + added > RESTART_INDEX)
+         {
+            CloseGlyphPiece(font, pieces.back());
+            pieces.push_back(OpenGlyphPiece(font));
+            shared = false;
+            count = 0;
+            added = controlCount;
+         }
+
+         GLushort patch[4];
+         if (!shared)
+         {
+            font->vertices.insert(font->vertices.end(), controls, controls + 2 * controlCount);
+            for (unsigned int i = 0; i < controlCount; i++)
+               patch[i] = GLushort(count + i);
+         }
+         else if (font->elevated)
+         {
+            GLuint inner = first + 1;
+            if (degree < 3)
+            {
+               font->vertices.insert(font->vertices.end(), cubic + 2, cubic + 6);
+               inner = count;
+            }
+            patch[0] = GLushort(first);
+            patch[1] = GLushort(inner);
+            patch[2] = GLushort(inner + 1);
+            patch[3] = GLushort(first + degree);
+         }
+         else
+         {
+            for (unsigned int i = 0; i <= degree; i++)
+               patch[i] = GLushort(first + i);
+         }
+         count += added;
+
+         if (font->elevated)
+            font->indices[CUBIC_CLASS].insert(font->indices[CUBIC_CLASS].end(), patch, patch + 4);
+         else if (degree == 1)
+            AddStripLine(lines, pieces.back().first[LINE_CLASS], patch[0], patch[1]);
+         else
+            font->indices[degree - 1].insert(font->indices[degree - 1].end(), patch, patch + degree + 1);
+      }
+   }
+
+   CloseGlyphPiece(font, pieces.back());
+   AddGlyphPieces(font, character, pieces);
+}
+
+// upload a font's pulled outlines into its buffer textures, and the indices
+// its draws count through, creating them on first use; returns true if
+// successful
+bool UpdatePulledGeometry(MyFontGeometry *font)
+{
+   PROFILE_SCOPE("UpdatePulledGeometry");
+   static const GLenum formats[3] = { GL_RG32F, GL_R32UI, GL_R8UI };
+   const void *data[3] = { font->points.data(), font->segments.data(), font->degrees.data() };
+   GLsizeiptr sizes[3] = { GLsizeiptr(font->points.size() * sizeof(GLfloat)),
+      GLsizeiptr(font->segments.size() * sizeof(GLuint)), GLsizeiptr(font->degrees.size()) };
+
+   // nothing is read per vertex, so the vertex array holds only the indices
+   // and, later, the instance offsets
+   MyGeometry *outline = &font->outline;
+   if (!outline->vertexArray)
+   {
+      glGenVertexArrays(1, &outline->vertexArray);
+      glGenBuffers(1, &outline->elementBuffer);
+      glGenBuffers(3, font->pullBuffers);
+      glGenTextures(3, font->pullTextures);
+      glObjectsCreated_ += 8;
+   }
+
+   for (int i = 0; i < 3; i++)
+   {
+      glBindBuffer(GL_TEXTURE_BUFFER, font->pullBuffers[i]);
+      FillBuffer(GL_TEXTURE_BUFFER, font->pullCapacities[i], sizes[i], data[i]);
+      glBindTexture(GL_TEXTURE_BUFFER, font->pullTextures[i]);
+      glTexBuffer(GL_TEXTURE_BUFFER, formats[i], font->pullBuffers[i]);
+   }
+   glBindTexture(GL_TEXTURE_BUFFER, 0);
+   glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+   const vector<GLushort> &sequence = font->indices[CUBIC_CLASS];
+   glBindVertexArray(outline->vertexArray);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, outline->elementBuffer);
+   FillBuffer(GL_ELEMENT_ARRAY_BUFFER, outline->indexCapacity, sequence.size() * sizeof(GLushort), sequence.data());
+   glBindVertexArray(0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+   outline->firstElement = 0;
+   outline->elementCount = GLsizei(4 * font->segments.size());
+   outline->indexCount = GLsizei(sequence.size());
+   fill(font->classFirst, font->classFirst + CLASS_COUNT, 0);
+
+   return !CheckGLErrors();
+}
+
+// deallocate a font's outlines on the GPU
+void DestroyFontGeometry(MyFontGeometry *font)
+{
+   DestroyGeometry(&font->outline);
+   glDeleteTextures(3, font->pullTextures);
+   glDeleteBuffers(3, font->pullBuffers);
+   fill(font->pullTextures, font->pullTextures + 3, 0);
+   fill(font->pullBuffers, font->pullBuffers + 3, 0);
+   fill(font->pullCapacities, font->pullCapacities + 3, 0);
+}
+
+// deallocate the outlines of every font
+void DestroyFonts(MyRenderer *renderer)
+{
+   for (map<pair<unsigned long, FontHandle>, MyFontGeometry>::iterator font = renderer->fonts.begin();
+      font != renderer->fonts.end(); ++font)
+      DestroyFontGeometry(&font->second);
+   renderer->fonts.clear();
+   renderer->textFont = 0;
+}
+
+// find the glyphs of the current text run that are in view, and when they
+// differ from last time, rebuild the instances and draws for just those
+// glyphs, so the work per frame is in what is visible rather than the length
+// of the run; returns true if successful
+bool UpdateTextInstances(MyRenderer *renderer, bool rebuild)
+{
+   PROFILE_SCOPE("UpdateTextInstances");
+   // these vertex attribute indices correspond to those specified for the
+   // input variables in the vertex shader
+   const GLuint INSTANCE_INDEX = 2;
+
+   MyFontGeometry *font = renderer->textFont;
+   if (!font || !textRun_)
+      return true;
+
+   // the view in run coordinates, undoing the view transform, and widened
+   // by the rounding of quantized outlines
+   GLfloat half = 1.0f / scale_ + POSITION_QUANTUM;
+   GLfloat window[4] = { -half - translation_, -half, half - translation_, half };
+   static vector<size_t> visible;
+   visible.clear();
+   TextLayout::FindGlyphs(*textRun_, window, visible);
+   if (!rebuild && visible == renderer->visibleGlyphs)
+      return true;
+   renderer->visibleGlyphs.swap(visible);
+
+   // sort the visible glyphs by character so each glyph's instances are
+   // consecutive
+   const vector<PositionedGlyph> &glyphs = textRun_->glyphs;
+   static vector<pair<int, size_t> > order;
+   order.clear();
+   for (size_t i = 0; i < renderer->visibleGlyphs.size(); i++)
+   {
+      size_t glyph = renderer->visibleGlyphs[i];
+      order.push_back(make_pair(glyphs[glyph].character, glyph));
+   }
+   sort(order.begin(), order.end());
+
+   // instance offsets, and one draw per glyph piece in each class it has
+   // indices in
+   MyGeometry *outline = &font->outline;
+   static vector<GLfloat> offsets;
+   offsets.clear();
+   renderer->commands.clear();
+   for (int c = 0; c < CLASS_COUNT; c++)
+   {
+      renderer->classCommands[c] = renderer->commands.size();
+      for (size_t i = 0; i < order.size(); )
+      {
+         size_t end = i;
+         while (end < order.size() && order[end].first == order[i].first)
+            end++;
+
+         for (const MyGlyphRange *piece = &font->glyphs[order[i].first]; piece;
+            piece = piece->next >= 0 ? &font->overflow[piece->next] : 0)
+         {
+            if (piece->count[c] > 0)
+            {
+               MyDrawCommand command;
+               command.count = GLuint(piece->count[c]);
+               command.instanceCount = GLuint(end - i);
+               command.firstIndex = GLuint(font->classFirst[c] + piece->first[c]);
+               command.baseVertex = outline->firstElement + piece->baseVertex;
+               command.baseInstance = GLuint(i);
+               renderer->commands.push_back(command);
+            }
+         }
+
+         if (c == 0)
+         {
+            for (size_t j = i; j < end; j++)
+            {
+               offsets.push_back(glyphs[order[j].second].x);
+               offsets.push_back(glyphs[order[j].second].y);
+            }
+         }
+         i = end;
+      }
+   }
+   renderer->classCommands[CLASS_COUNT] = renderer->commands.size();
+   if (offsets.empty() || !outline->vertexArray)
+      return true;
+
+   if (!renderer->instanceBuffer)
+   {
+      glGenBuffers(1, &renderer->instanceBuffer);
+      glObjectsCreated_++;
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, renderer->instanceBuffer);
+   FillBuffer(GL_ARRAY_BUFFER, renderer->instanceCapacity, offsets.size() * sizeof(GLfloat), offsets.data());
+
+   // the outline's vertex array reads one offset per instance
+   glBindVertexArray(outline->vertexArray);
+   glVertexAttribPointer(INSTANCE_INDEX, 2, GL_FLOAT, GL_FALSE, 0, 0);
+   glVertexAttribDivisor(INSTANCE_INDEX, 1);
+   glEnableVertexAttribArray(INSTANCE_INDEX);
+   glBindVertexArray(0);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   // each class with anything to draw is a pass with its own program; within
+   // it, the draws themselves can be read from a buffer by a single
+   // multi-draw
+   if (multiDrawElementsIndirect_ && !renderer->commands.empty())
+   {
+      if (!renderer->commandBuffer)
+      {
+         glGenBuffers(1, &renderer->commandBuffer);
+         glObjectsCreated_++;
+      }
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderer->commandBuffer);
+      FillBuffer(GL_DRAW_INDIRECT_BUFFER, renderer->commandCapacity, renderer->commands.size() * sizeof(MyDrawCommand),
+         renderer->commands.data());
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+   }
+
+   return !CheckGLErrors();
+}
+
+// prepare the current text run for drawing: upload any glyphs its font has
+// not shown before, then the instances and draws of the glyphs in view;
+// returns true if successful
+bool UpdateText(MyRenderer *renderer, int width, bool report = true)
+{
+   PROFILE_SCOPE("UpdateText");
+   renderer->textFont = 0;
+   renderer->commands.clear();
+   fill(renderer->classCommands, renderer->classCommands + CLASS_COUNT + 1, 0);
+   if (!textRun_)
+      return true;
+
+   const GlyphExtractor &extractor = textLayout_->Extractor();
+   MyFontGeometry *font = &renderer->fonts[make_pair(extractor.Serial(), textRun_->font)];
+
+   // keep flattened lines within a quarter pixel of the curves; the text is
+   // scaled by scale_ and one unit is half the framebuffer, so the outlines
+   // are rebuilt when the scale or the flattening mode changes
+   GLfloat tolerance = flattenCurves_ ? 0.25f / (scale_ * 0.5f * width) : 0.0f;
+   bool elevated = elevateCurves_ && !flattenCurves_;
+   bool pulled = pullVertices_ && !flattenCurves_ && hasTessellation_;
+   if (tolerance != font->tolerance || elevated != font->elevated || pulled != font->pulled)
+   {
+      font->glyphs.clear();
+      font->overflow.clear();
+      font->vertices.clear();
+      for (int c = 0; c < CLASS_COUNT; c++)
+         font->indices[c].clear();
+      font->points.clear();
+      font->segments.clear();
+      font->degrees.clear();
+      font->tolerance = tolerance;
+      font->elevated = elevated;
+   }
+
+   // text is one colour, so only positions are stored per vertex; buffers
+   // are made again when the position format changes, or when switching to
+   // or from pulling
+   MyGeometry *outline = &font->outline;
+   bool reformatted = false;
+   if (outline->quantized != quantizePositions_ || outline->perVertexColour || pulled != font->pulled)
+   {
+      DestroyFontGeometry(font);
+      font->pulled = pulled;
+      outline->quantized = quantizePositions_;
+      outline->perVertexColour = false;
+      outline->colour[0] = 1.0f;
+      outline->colour[1] = 0.0f;
+      outline->colour[2] = 0.0f;
+      reformatted = true;
+   }
+
+   // add outlines for glyphs not seen before
+   const vector<PositionedGlyph> &glyphs = textRun_->glyphs;
+   vector<int> characters;
+   characters.reserve(glyphs.size());
+   size_t added = 0;
+   for (size_t i = 0; i < glyphs.size(); i++)
+   {
+      int character = glyphs[i].character;
+      characters.push_back(character);
+      if (font->glyphs.find(character) == font->glyphs.end())
+      {
+         AddFontGlyph(font, character, extractor.ExtractPackedGlyph(character));
+         added++;
+      }
+   }
+   sort(characters.begin(), characters.end());
+   size_t uniqueGlyphs = unique(characters.begin(), characters.end()) - characters.begin();
+
+   // upload the font's outlines again only when they grew or changed format,
+   // with the indices of every class in one buffer
+   size_t uploaded = 0, uploadedBytes = 0;
+   if ((added || reformatted) && font->pulled)
+   {
+      if (!UpdatePulledGeometry(font))
+         return false;
+      uploaded = font->points.size() / 2;
+      uploadedBytes = font->points.size() * sizeof(GLfloat) + font->segments.size() * sizeof(GLuint) +
+         font->degrees.size() + font->indices[CUBIC_CLASS].size() * sizeof(GLushort);
+   }
+   else if (added || reformatted)
+   {
+      static const vector<GLfloat> none;
+      static vector<GLushort> indices;
+      indices.clear();
+      for (int c = 0; c < CLASS_COUNT; c++)
+      {
+         font->classFirst[c] = GLint(indices.size());
+         indices.insert(indices.end(), font->indices[c].begin(), font->indices[c].end());
+      }
+      if (!UpdateGeometry(outline, font->vertices, none, indices))
+         return false;
+      uploaded = font->vertices.size() / 2;
+      uploadedBytes = uploaded * (PositionBytes(outline) + ColourBytes(outline)) + indices.size() * sizeof(GLushort);
+   }
+
+   // draw what is in view
+   renderer->textFont = font;
+   renderer->visibleGlyphs.clear();
+   if (!UpdateTextInstances(renderer, true))
+      return false;
+
+   size_t passes = 0;
+   for (int c = 0; c < CLASS_COUNT; c++)
+      passes += renderer->classCommands[c + 1] > renderer->classCommands[c] ? 1 : 0;
+   size_t draws = multiDrawElementsIndirect_ ? passes : renderer->commands.size();
+
+   if (report)
+      cout << "Text: " << glyphs.size() << " glyphs (" << renderer->visibleGlyphs.size() << " in view), " << uniqueGlyphs << " unique ("
+         << added << " new), " << uploaded << " outline vertices uploaded in " << uploadedBytes << " bytes"
+         << (font->pulled ? " to be pulled" : font->elevated ? " as cubics" : "") << ", " << draws << " draw calls in "
+         << passes << " passes" << endl;
+
+   return !CheckGLErrors();
+}
+
+// draw one primitive class of the current text
+void RenderText(MyRenderer *renderer, int primitiveClass, MyShader *shader, GLenum renderMode)
+{
+   PROFILE_SCOPE("RenderText");
+   const GLuint INSTANCE_INDEX = 2;
+
+   size_t first = renderer->classCommands[primitiveClass];
+   size_t last = renderer->classCommands[primitiveClass + 1];
+   if (!renderer->textFont || first == last)
+      return;
+
+   UseShader(shader);
+   BindGeometry(&renderer->textFont->outline, shader);
+
+   // pulled outlines are read from buffer textures
+   const MyFontGeometry *font = renderer->textFont;
+   if (font->pulled)
+   {
+      for (int i = 0; i < 3; i++)
+      {
+         glActiveTexture(GL_TEXTURE0 + i);
+         glBindTexture(GL_TEXTURE_BUFFER, font->pullTextures[i]);
+      }
+   }
+
+   if (multiDrawElementsIndirect_)
+   {
+      // every glyph of the class in one call
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderer->commandBuffer);
+      multiDrawElementsIndirect_(renderMode, GL_UNSIGNED_SHORT,
+         reinterpret_cast<const void *>(first * sizeof(MyDrawCommand)), GLsizei(last - first), 0);
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+   }
+   else if (drawElementsInstancedBaseVertexBaseInstance_)
+   {
+      for (size_t i = first; i < last; i++)
+      {
+         const MyDrawCommand &command = renderer->commands[i];
+         drawElementsInstancedBaseVertexBaseInstance_(renderMode, command.count, GL_UNSIGNED_SHORT,
+            reinterpret_cast<const void *>(command.firstIndex * sizeof(GLushort)),
+            command.instanceCount, command.baseVertex, command.baseInstance);
+      }
+   }
+   else
+   {
+      // without base instances, point the offsets at each glyph's first
+      glBindBuffer(GL_ARRAY_BUFFER, renderer->instanceBuffer);
+      for (size_t i = first; i < last; i++)
+      {
+         const MyDrawCommand &command = renderer->commands[i];
+         glVertexAttribPointer(INSTANCE_INDEX, 2, GL_FLOAT, GL_FALSE, 0,
+            reinterpret_cast<const void *>(command.baseInstance * 2 * sizeof(GLfloat)));
+         glDrawElementsInstancedBaseVertex(renderMode, command.count, GL_UNSIGNED_SHORT,
+            reinterpret_cast<const void *>(command.firstIndex * sizeof(GLushort)),
+            command.instanceCount, command.baseVertex);
+      }
+      glVertexAttribPointer(INSTANCE_INDEX, 2, GL_FLOAT, GL_FALSE, 0, 0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+
+   // reset state to default (no shader, geometry or textures bound)
+   if (font->pulled)
+   {
+      for (int i = 2; i >= 0; i--)
+      {
+         glActiveTexture(GL_TEXTURE0 + i);
+         glBindTexture(GL_TEXTURE_BUFFER, 0);
+      }
+   }
+   glBindVertexArray(0);
+   ResetShader(shader);
+
+   // check for an report any OpenGL errors
+   CheckGLErrors();
+}
+
+// compile the shaders for the current context and load the draw functions
+// it supports through the given loader, returning true if successful
+bool InitializeRenderer(MyRenderer *renderer, GLADloadproc load)
+{
+   PROFILE_SCOPE("InitializeRenderer");
+   MyShaderLibrary *shaders = &renderer->shaders;
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   InitializeShaderLibrary(shaders, load);
+
+   if (!InitializeShaders(shaders, &renderer->lineShader))
+      return false;
+   if (hasTessellation_ &&
+      !InitializeShaders(shaders, &renderer->quadraticShader, "quadraticTessControl.glsl", "quadraticTessEval.glsl"))
+      return false;
+   if (hasTessellation_ &&
+      !InitializeShaders(shaders, &renderer->cubicShader, "cubicTessControl.glsl", "cubicTessEval.glsl"))
+      return false;
+   if (hasTessellation_ &&
+      !InitializeShaders(shaders, &renderer->pulledShader, "cubicTessControl.glsl", "cubicTessEval.glsl", "pulledVertex.glsl"))
+      return false;
+
+   // the rest of the setup goes ahead while the driver builds the programs
+   glPointSize(5.0f);
+   glGenQueries(1, &renderer->primitivesQuery);
+
+   // line strips are separated by a reserved index
+   glEnable(GL_PRIMITIVE_RESTART);
+   glPrimitiveRestartIndex(RESTART_INDEX);
+   LoadDrawFunctions(load);
+
+   if (!FinishShaders(shaders))
+      return false;
+   MyShader *all[] = { &renderer->lineShader, &renderer->quadraticShader, &renderer->cubicShader, &renderer->pulledShader };
+   for (int i = 0; i < 4; i++) {
+      if (all[i]->vertexProgram)
+         QueryUniforms(all[i]);
+   }
+
+   // pulled outlines are read from these texture units
+   if (hasTessellation_)
+   {
+      GLuint program = renderer->pulledShader.vertexProgram;
+      glUseProgram(program);
+      glUniform1i(glGetUniformLocation(program, "Points"), 0);
+      glUniform1i(glGetUniformLocation(program, "Segments"), 1);
+      glUniform1i(glGetUniformLocation(program, "Degrees"), 2);
+      glUseProgram(0);
+   }
+
+   // programs are only linked on a cold start, with the cache empty or out
+   // of date; after that they load from it
+   double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+   cout << "Shaders ready in " << milliseconds << " ms, " << (shaders->separable ? "separable" : "linked whole")
+      << (shaders->parallel ? " on driver threads" : "")
+      << ": " << shaders->loaded << " programs loaded from the cache, " << shaders->linked << " linked from "
+      << shaders->stages.size() << " compiled stages of " << shaders->sources.size() << " sources, "
+      << shaders->shared << " shared" << endl;
+   if (shaders->binaries)
+      shaders->cache.Save();
+
+   return !CheckGLErrors();
+}
+
+// clear the bound framebuffer and draw the scene into it, uploading geometry
+// first if it was rebuilt since the last frame
+void DrawScene(MyRenderer *renderer, int width, int height)
+{
+   PROFILE_SCOPE("DrawScene");
+   // clear screen to a dark grey colour
+   glViewport(0, 0, width, height);
+   glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+   glClear(GL_COLOR_BUFFER_BIT);
+
+   // tessellation levels are chosen in pixels
+   viewportWidth_ = width;
+   viewportHeight_ = height;
+
+   // upload geometry only when it was rebuilt; scrolling just moves it
+   if (geometryChanged_)
+   {
+      static const vector<GLfloat> none;
+      flatVertices_.clear();
+      flatColours_.clear();
+
+      if (flattenCurves_)
+      {
+         PROFILE_SCOPE("Flatten curves");
+
+         // keep lines within a quarter pixel of the curves; the geometry
+         // is scaled by scale_ and one unit is half the framebuffer
+         GLfloat tolerance = 0.25f / (scale_ * 0.5f * width);
+
+         flattener_.AddQuadratics(quadraticVertices_.data(), quadraticVertices_.size() / 6);
+         flattener_.AddCubics(cubicVertices_.data(), cubicVertices_.size() / 8);
+         size_t curves = flattener_.CurveCount();
+         flattener_.Flatten(tolerance, flatVertices_);
+
+         // curves are drawn in a single colour
+         const vector<GLfloat> &colours = quadraticColours_.size() ? quadraticColours_ : cubicColours_;
+         for (size_t i = 0; colours.size() && i < flatVertices_.size() / 2; i++)
+            flatColours_.insert(flatColours_.end(), colours.begin(), colours.begin() + 3);
+
+         if (curves)
+            cout << "Flattened " << curves << " curves into " << flatVertices_.size() / 4
+               << " lines (fixed tessellation would emit " << curves * 30 << ")" << endl;
+      }
+
+      // every geometry is updated even if an earlier one fails, so none is
+      // left drawing the previous scene
+      bool updated = UpdateGeometry(&renderer->pointGeometry, pointVertices_, pointColours_);
+      updated &= UpdateGeometry(&renderer->lineGeometry, lineVertices_, lineColours_, lineIndices_);
+      updated &= UpdateGeometry(&renderer->quadraticGeometry, flattenCurves_ ? none : quadraticVertices_, quadraticColours_);
+      updated &= UpdateGeometry(&renderer->cubicGeometry, flattenCurves_ ? none : cubicVertices_, cubicColours_);
+      updated &= UpdateGeometry(&renderer->flatGeometry, flatVertices_, flatColours_);
+      updated &= UpdateText(renderer, width);
+      if (!updated)
+         cout << "Program failed to initialize geometry!" << endl;
+
+      geometryChanged_ = false;
+   }
+
+   // streamed text changes only the text
+   else if (textChanged_)
+   {
+      if (!UpdateText(renderer, width, false))
+         cout << "Program failed to update text!" << endl;
+   }
+
+   // scrolling brings glyphs into view and takes others out
+   else if (!UpdateTextInstances(renderer, false))
+      cout << "Program failed to update text instances!" << endl;
+   textChanged_ = false;
+
+   // render control points
+   if (renderer->pointGeometry.elementCount)
+      RenderScene(&renderer->pointGeometry, &renderer->lineShader, GL_POINTS);
+
+   // render lines
+   if (renderer->lineGeometry.elementCount)
+      RenderScene(&renderer->lineGeometry, &renderer->lineShader, GL_LINE_STRIP);
+
+   // render the straight segments of text, unless they include curves
+   bool textFlattened = renderer->textFont && renderer->textFont->tolerance > 0.0f;
+   if (!textFlattened)
+      RenderText(renderer, LINE_CLASS, &renderer->lineShader, GL_LINE_STRIP);
+
+   if (reportPrimitives_)
+      glBeginQuery(GL_PRIMITIVES_GENERATED, renderer->primitivesQuery);
+
+   // render text flattened on the CPU
+   if (textFlattened)
+      RenderText(renderer, LINE_CLASS, &renderer->lineShader, GL_LINE_STRIP);
+
+   // render curves flattened on the CPU
+   if (renderer->flatGeometry.elementCount)
+      RenderScene(&renderer->flatGeometry, &renderer->lineShader, GL_LINES);
+
+   // render quadratic bezier curves
+   if (renderer->quadraticGeometry.elementCount)
+   {
+      glPatchParameteri(GL_PATCH_VERTICES, 3);
+      RenderScene(&renderer->quadraticGeometry, &renderer->quadraticShader, GL_PATCHES);
+   }
+
+   // render cubic bezier curves
+   if (renderer->cubicGeometry.elementCount)
+   {
+      glPatchParameteri(GL_PATCH_VERTICES, 4);
+      RenderScene(&renderer->cubicGeometry, &renderer->cubicShader, GL_PATCHES);
+   }
+
+   // render the curves of text, tessellated like the curves above
+   if (renderer->classCommands[CUBIC_CLASS] > renderer->classCommands[QUADRATIC_CLASS])
+   {
+      glPatchParameteri(GL_PATCH_VERTICES, 3);
+      RenderText(renderer, QUADRATIC_CLASS, &renderer->quadraticShader, GL_PATCHES);
+   }
+   if (renderer->classCommands[CLASS_COUNT] > renderer->classCommands[CUBIC_CLASS])
+   {
+      glPatchParameteri(GL_PATCH_VERTICES, 4);
+      bool pulled = renderer->textFont && renderer->textFont->pulled;
+      RenderText(renderer, CUBIC_CLASS, pulled ? &renderer->pulledShader : &renderer->cubicShader, GL_PATCHES);
+   }
+
+   // report line pieces emitted for curves when the count changes; this
+   // waits for the GPU, so it is only done on request
+   if (reportPrimitives_)
+   {
+      glEndQuery(GL_PRIMITIVES_GENERATED);
+      GLuint primitives = 0;
+      glGetQueryObjectuiv(renderer->primitivesQuery, GL_QUERY_RESULT, &primitives);
+      if (primitives != renderer->lastPrimitives)
+         cout << "Curve primitives generated: " << primitives << endl;
+      renderer->lastPrimitives = primitives;
+   }
+}
+
+// deallocate everything the renderer created
+void DestroyRenderer(MyRenderer *renderer)
+{
+   PROFILE_SCOPE("DestroyRenderer");
+   DestroyGeometry(&renderer->pointGeometry);
+   DestroyGeometry(&renderer->lineGeometry);
+   DestroyGeometry(&renderer->quadraticGeometry);
+   DestroyGeometry(&renderer->cubicGeometry);
+   DestroyGeometry(&renderer->flatGeometry);
+   DestroyFonts(renderer);
+   glDeleteBuffers(1, &renderer->instanceBuffer);
+   glDeleteBuffers(1, &renderer->commandBuffer);
+   renderer->instanceBuffer = 0;
+   renderer->commandBuffer = 0;
+   renderer->instanceCapacity = 0;
+   renderer->commandCapacity = 0;
+   glDeleteQueries(1, &renderer->primitivesQuery);
+   renderer->primitivesQuery = 0;
+   DestroyShaders(&renderer->shaders);
+}
+
+// --------------------------------------------------------------------------
+// Functions to set up framebuffer objects for rendering without a window
+
+struct MyFramebuffer
+{
+   // OpenGL names for the multisampled framebuffer we draw into, and the
+   // single-sampled one it is resolved into for reading back
+   GLuint  multisampleFramebuffer;
+   GLuint  multisampleColour;
+   GLuint  resolveFramebuffer;
+   GLuint  resolveColour;
+   GLsizei width;
+   GLsizei height;
+
+   // initialize object names to zero (OpenGL reserved value)
+   MyFramebuffer() : multisampleFramebuffer(0), multisampleColour(0),
+      resolveFramebuffer(0), resolveColour(0), width(0), height(0)
+   {}
+};
+
+// create RGBA8 framebuffers of the given size, leaving the multisampled one
+// bound for drawing, returning true if successful
+bool InitializeFramebuffer(MyFramebuffer *framebuffer, GLsizei width, GLsizei height, GLsizei samples)
+{
+   framebuffer->width = width;
+   framebuffer->height = height;
+
+   glGenRenderbuffers(1, &framebuffer->resolveColour);
+   glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->resolveColour);
+   glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+   glGenFramebuffers(1, &framebuffer->resolveFramebuffer);
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->resolveFramebuffer);
+   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, framebuffer->resolveColour);
+   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      return false;
+
+   // match the antialiasing the window asks for
+   glGenRenderbuffers(1, &framebuffer->multisampleColour);
+   glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->multisampleColour);
+   glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+   glGenFramebuffers(1, &framebuffer->multisampleFramebuffer);
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->multisampleFramebuffer);
+   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, framebuffer->multisampleColour);
+   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      return false;
+
+   glBindRenderbuffer(GL_RENDERBUFFER, 0);
+   return !CheckGLErrors();
+}
+
+// resolve the multisampled framebuffer and read it back as top-down RGBA rows
+void ReadFramebuffer(MyFramebuffer *framebuffer, vector<unsigned char> &pixels)
+{
+   GLsizei width = framebuffer->width, height = framebuffer->height;
+
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->multisampleFramebuffer);
+   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer->resolveFramebuffer);
+   glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+   // OpenGL rows start at the bottom, images at the top
+   vector<unsigned char> rows(width * height * 4);
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->resolveFramebuffer);
+   glPixelStorei(GL_PACK_ALIGNMENT, 1);
+   glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+   pixels.resize(rows.size());
+   for (GLsizei y = 0; y < height; y++)
+      copy(rows.begin() + (height - 1 - y) * width * 4, rows.begin() + (height - y) * width * 4,
+         pixels.begin() + y * width * 4);
+
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->multisampleFramebuffer);
+}
+
+// deallocate framebuffer-related objects
+void DestroyFramebuffer(MyFramebuffer *framebuffer)
+{
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   glDeleteFramebuffers(1, &framebuffer->multisampleFramebuffer);
+   glDeleteFramebuffers(1, &framebuffer->resolveFramebuffer);
+   glDeleteRenderbuffers(1, &framebuffer->multisampleColour);
+   glDeleteRenderbuffers(1, &framebuffer->resolveColour);
+   *framebuffer = MyFramebuffer();
+}
+
+// --------------------------------------------------------------------------
+// GLFW callback functions
+
+// reports GLFW errors
+void ErrorCallback(int error, const char* description)
+{
+   cout << "GLFW ERROR " << error << ":" << endl;
+   cout << description << endl;
+}
+
+// redraw when the window changes size or its contents are lost
+void ResizeCallback(GLFWwindow* window, int width, int height)
+{
+   needsRedraw_ = true;
+}
+
+void RefreshCallback(GLFWwindow* window)
+{
+   needsRedraw_ = true;
+}
+
+// true if the current context can swap late frames without waiting
+bool SupportsAdaptiveSync()
+{
+   return glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+      glfwExtensionSupported("GLX_EXT_swap_control_tear");
+}
+
+// handles keyboard input events
+void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+   // key handling counts towards the frame that follows
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+      glfwSetWindowShouldClose(window, GL_TRUE);
+   else if (key == GLFW_KEY_F && action == GLFW_PRESS)
+   {
+      // without tessellation shaders, curves can only be drawn flattened
+      if (hasTessellation_)
+      {
+         flattenCurves_ = !flattenCurves_;
+         geometryChanged_ = true;
+         needsRedraw_ = true;
+      }
+   }
+   else if (key == GLFW_KEY_E && action == GLFW_PRESS)
+   {
+      // only matters for curves drawn by the tessellation shaders
+      elevateCurves_ = !elevateCurves_;
+      cout << "Text outlines: " << (elevateCurves_ ? "all cubic" : "lines, quadratics and cubics") << endl;
+      geometryChanged_ = true;
+      needsRedraw_ = true;
+   }
+   else if (key == GLFW_KEY_V && action == GLFW_PRESS)
+   {
+      // only matters for curves drawn by the tessellation shaders
+      pullVertices_ = !pullVertices_;
+      cout << "Text outlines: " << (pullVertices_ ? "pulled from buffer textures" : "vertex arrays") << endl;
+      geometryChanged_ = true;
+      needsRedraw_ = true;
+   }
+   else if (key == GLFW_KEY_S && action == GLFW_PRESS)
+   {
+      // cycle the swap policy, skipping adaptive sync where it is missing
+      int policy = scheduler_.Policy();
+      do
+         policy = (policy + 1) % FrameScheduler::SWAP_POLICY_COUNT;
+      while (policy == FrameScheduler::ADAPTIVE_VSYNC && !SupportsAdaptiveSync());
+      scheduler_.SetPolicy(FrameScheduler::SwapPolicy(policy));
+      glfwSwapInterval(scheduler_.SwapInterval());
+      cout << "Swap: " << FrameScheduler::PolicyName(scheduler_.Policy()) << endl;
+      needsRedraw_ = true;
+   }
+   else if (key == GLFW_KEY_Q && action == GLFW_PRESS)
+   {
+      quantizePositions_ = !quantizePositions_;
+      cout << "Text positions: " << (quantizePositions_ ? "16-bit fixed point" : "32-bit float") << endl;
+      geometryChanged_ = true;
+      needsRedraw_ = true;
+   }
+   else if (key == GLFW_KEY_A && action == GLFW_PRESS)
+   {
+      adaptiveTessellation_ = !adaptiveTessellation_;
+      cout << "Tessellation: " << (adaptiveTessellation_ ? "adaptive" : "fixed at 30") << endl;
+      needsRedraw_ = true;
+   }
+   else if (key == GLFW_KEY_P && action == GLFW_PRESS)
+   {
+      reportPrimitives_ = !reportPrimitives_;
+      needsRedraw_ = true;
+   }
+   else if (key == GLFW_KEY_D && action == GLFW_PRESS)
+      WriteProfile(profileFile_);
+   else if (key == GLFW_KEY_B && action == GLFW_PRESS)
+   {
+      needsRedraw_ = true;
+      isScrolling_ = false;
+
+      isQuadratic_ = !isQuadratic_;
 
       if (isQuadratic_)
       {
@@ -654,72 +2456,578 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
    }
    else if (key == GLFW_KEY_N && action == GLFW_PRESS)
    {
-      needsRedraw_ = true;
-      isScrolling_ = false;
+      // the name is held still, placed to suit each font
+      static const GLfloat translations[] = { -.99f, -0.91f, -0.85f };
 
-      if (currNameFont == Lora)
+      MyTextSwitch settings = { false, false, translations[currNameFont], minOffset_ };
+      SwitchText(fontFiles_[currNameFont], "Amy", settings);
+      currNameFont = static_cast<Font>((currNameFont + 1) % 3);
+   }
+   else if (key == GLFW_KEY_T && action == GLFW_PRESS)
+   {
+      // the text scrolls, starting over once all of it has gone by
+      static const GLfloat minOffsets[] = { -16.0f, -23.0f, -13.0f };
+
+      MyTextSwitch settings = { true, hasMarquee_, 0.0f, minOffsets[currTextFont - AlexBrush] };
+      SwitchText(fontFiles_[currTextFont], hasMarquee_ ? "" : "The quick brown fox jumps over the lazy dog.", settings);
+
+      currTextFont = static_cast<Font>(currTextFont + 1);
+      if (currTextFont == 6)
       {
-         //Load a font file
-         extractor_.LoadFontFile("fonts/lora/Lora-Regular.ttf");
-         initFont(extractor_, "Amy", -.99f);
+         currTextFont = static_cast<Font>(3);
       }
-      else if (currNameFont == SourceSansPro)
+   }
+   else if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS)
+   {
+      multiplier_ -= 0.2f;
+      if (multiplier_ <= 0)
       {
-         //Load a font file
-         extractor_.LoadFontFile("fonts/source-sans-pro/SourceSansPro-Regular.otf");
-         initFont(extractor_, "Amy", -0.91f);
+         multiplier_ = 0.1f;
       }
-      else if (currNameFont == GreatVibes)
+   }
+   else if (key == GLFW_KEY_LEFT && action == GLFW_PRESS)
+   {
+      multiplier_ += 0.2f;
+   }
+
+   keySeconds_ += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// --------------------------------------------------------------------------
+// Command-line tools
+
+// times extraction of every glyph in a font with increasing thread counts
+int BenchmarkExtraction(const string &filename)
+{
+   GlyphExtractor extractor;
+   if (!extractor.LoadFontFile(filename))
+      return -1;
+
+   vector<int> characters = extractor.CharacterCodes();
+   cout << "Extracting " << characters.size() << " glyphs from " << filename << endl;
+
+   unsigned int cores = max(1u, thread::hardware_concurrency());
+   double baseline = 0.0;
+   for (unsigned int threads = 1; ; threads = min(threads * 2, cores))
+   {
+      // best of a few runs, to keep thread start-up noise out of the numbers
+      double best = 0.0;
+      for (int run = 0; run < 3; run++)
       {
-         //Load a font file
-         extractor_.LoadFontFile("fonts/great-vibes/GreatVibes-Regular.otf");
-         initFont(extractor_, "Amy", -0.85f);
+         chrono::steady_clock::time_point start = chrono::steady_clock::now();
+         vector<MyPackedGlyphStorage> glyphs = extractor.ExtractGlyphs(characters, threads);
+         if (glyphs.size() != characters.size())
+            return -1;
+         double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+         if (run == 0 || seconds < best) best = seconds;
       }
+      if (threads == 1) baseline = best;
 
-      currNameFont = static_cast<Font>((currNameFont + 1) % 3);
+      cout << "  " << threads << " thread(s): " << best * 1000.0 << " ms, "
+         << characters.size() / best << " glyphs/s, speedup "
+         << baseline / best << "x" << endl;
+
+      if (threads == cores) break;
    }
-   else if (key == GLFW_KEY_T && action == GLFW_PRESS)
+
+   return 0;
+}
+
+// writes a text file of at least the given size from words that include
+// accented letters and typographic punctuation, returning the number of
+// characters the marquee will show for it, or 0 if it could not be written
+unsigned long long WriteMarqueeText(const string &filename, size_t bytes)
+{
+   static const char *words[] = {
+      "The", "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog",
+      "caf\xC3\xA9", "na\xC3\xAFve", "fa\xC3\xA7" "ade", "r\xC3\xA9sum\xC3\xA9", "\xE2\x80\x94",
+      "\xE2\x80\x9Cquoted\xE2\x80\x9D", "zephyrs", "blow,", "vexing", "daft", "Jim.", "0123456789"
+   };
+   const size_t wordCount = sizeof(words) / sizeof(words[0]);
+
+   ofstream file(filename.c_str(), ios::binary);
+   if (!file)
+      return 0;
+
+   // words are separated by single spaces or line breaks, each shown as one
+   // space; the last separator is dropped at the end of the file
+   unsigned long long characters = 0;
+   unsigned int random = 1;
+   for (size_t written = 0; written < bytes; )
    {
-      needsRedraw_ = true;
-      isScrolling_ = true;
+      random = random * 1664525u + 1013904223u;
+      string word = words[(random >> 8) % wordCount];
+      word += (random >> 24) % 12 == 0 ? "\r\n" : " ";
+      file << word;
+      written += word.size();
+
+      for (size_t i = 0; i < word.size(); i++)
+         characters += (static_cast<unsigned char>(word[i]) & 0xC0) != 0x80 && word[i] != '\r' ? 1 : 0;
+   }
+   return file ? characters - 1 : 0;
+}
+
+// scrolls a text file through the marquee from start to end, half an EM per
+// frame, checking that the glyphs held always cover the view and timing the
+// layout and culling a frame needs at each tenth of the file; without a file,
+// a generated one of the given size (8 MB by default) is scrolled and then
+// deleted. Returns 0 if every check passed.
+int BenchmarkMarquee(int count, char *arguments[])
+{
+   size_t megabytes = 8;
+   int first = 0;
+   for (; first + 1 < count && string(arguments[first]) == "--size"; first += 2)
+      megabytes = size_t(max(1, atoi(arguments[first + 1])));
+
+   string filename = first < count ? arguments[first] : "marquee-bench.txt";
+   unsigned long long expected = 0;
+   if (first >= count)
+   {
+      expected = WriteMarqueeText(filename, megabytes << 20);
+      if (!expected) {
+         cout << "Could not write " << filename << endl;
+         return -1;
+      }
+   }
 
-      if (currTextFont == AlexBrush)
+   int failures = 0;
+   {
+      GlyphExtractor extractor;
+      TextLayout layout(extractor);
+      TextStream stream(layout);
+      if (!extractor.LoadFontFile("fonts/lora/Lora-Regular.ttf") || !stream.Open(filename))
+         return -1;
+      size_t bytes = 0;
       {
-         //Load a font file
-         minOffset_ = -16.0f;
-         extractor_.LoadFontFile("fonts/alex-brush/AlexBrush-Regular.ttf");
+         ifstream file(filename.c_str(), ios::binary | ios::ate);
+         bytes = size_t(file.tellg());
       }
-      else if (currTextFont == Inconsolata)
+      cout << "Scrolling " << bytes << " bytes of " << filename << endl;
+
+      // the view, as the window shows it
+      scale_ = 0.90f;
+      double half = 1.0 / scale_;
+      double offset = 1.1;
+
+      vector<size_t> visible;
+      size_t peakHeld = 0, peakCapacity = 0;
+      unsigned long long frames = 0, visibleTotal = 0;
+      double tenthSeconds[10] = { 0 };
+      unsigned long long tenthFrames[10] = { 0 };
+      while (!stream.Finished())
       {
-         //Load a font file
-         minOffset_ = -23.0f;
-         extractor_.LoadFontFile("fonts/inconsolata/Inconsolata.otf");
+         chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+         // the work of a frame outside of drawing: streaming, then culling
+         // as UpdateTextInstances does
+         ScrollMarquee(stream, offset);
+         GLfloat viewHalf = GLfloat(half) + POSITION_QUANTUM;
+         GLfloat window[4] = { -viewHalf - translation_, -viewHalf, viewHalf - translation_, viewHalf };
+         visible.clear();
+         TextLayout::FindGlyphs(stream.Run(), window, visible);
+
+         double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+         size_t tenth = min<size_t>(9, bytes ? stream.BytesRead() * 10 / bytes : 0);
+         tenthSeconds[tenth] += seconds;
+         tenthFrames[tenth]++;
+
+         // nothing in view may have been dropped, and the glyphs laid out
+         // must reach past the view unless the file has run out
+         double left = -half - offset, right = half - offset;
+         const GlyphRun &run = stream.Run();
+         bool covered = stream.DroppedTo() < left &&
+            (stream.Origin() + run.advance >= right || stream.BytesRead() >= bytes);
+         if (!covered && failures++ < 10)
+            cout << "  FAILED: view [" << left << ", " << right << "] not covered at frame " << frames << endl;
+
+         peakHeld = max(peakHeld, run.glyphs.size());
+         peakCapacity = max(peakCapacity, run.glyphs.capacity());
+         visibleTotal += visible.size();
+         frames++;
+         offset -= 0.5;
+      }
+
+      cout << "  " << frames << " frames, " << stream.CharactersLaidOut() << " characters laid out, "
+         << double(visibleTotal) / max(frames, 1ull) << " glyphs in view on average" << endl;
+      cout << "  at most " << peakHeld << " glyphs held, in " << peakCapacity * sizeof(PositionedGlyph)
+         << " bytes" << endl;
+      cout << "  microseconds per frame by tenth of the file:";
+      for (int i = 0; i < 10; i++)
+         cout << " " << (tenthFrames[i] ? 1e6 * tenthSeconds[i] / tenthFrames[i] : 0.0);
+      cout << endl;
+
+      if (expected && stream.CharactersLaidOut() != expected) {
+         cout << "  FAILED: expected " << expected << " characters" << endl;
+         failures++;
       }
-      else if (currTextFont == Amatic)
+   }
+
+   if (first >= count)
+      remove(filename.c_str());
+   cout << (failures ? "FAILED" : "Passed") << endl;
+   return failures ? -1 : 0;
+}
+
+// converts fonts into outline packs, which are then used instead of the
+// fonts themselves whenever they are loaded
+int PackFonts(int count, char *filenames[])
+{
+   for (int i = 0; i < count; i++)
+   {
+      // decode from the font itself, even if an older pack exists
+      GlyphExtractor extractor;
+      extractor.UseOutlinePacks(false);
+      if (!extractor.LoadFontFile(filenames[i]))
+         return -1;
+
+      string packname = OutlinePackFilename(filenames[i]);
+      if (!WriteOutlinePack(extractor, packname))
+         return -1;
+      cout << "Wrote " << packname << endl;
+   }
+
+   return 0;
+}
+
+// fills a string on the CPU with its origin at (x, y) pixels from the bottom
+// left, one EM spanning size pixels
+void RasterizeText(GlyphRasterizer &rasterizer, TextLayout &layout, const string &words,
+   GLfloat x, GLfloat y, GLfloat size)
+{
+   const GlyphRun &run = layout.Layout(words);
+   for (unsigned int i = 0; i < run.glyphs.size(); i++)
+   {
+      MyPackedGlyph glyph = layout.Extractor().ExtractPackedGlyph(run.glyphs[i].character);
+      rasterizer.AddGlyph(glyph, x + run.glyphs[i].x * size, y + run.glyphs[i].y * size, size);
+   }
+}
+
+// renders strings into offscreen framebuffers and writes them out as PNGs;
+// each job is a mode (tessellated, elevated, pulled, flattened or filled), a font, a string and
+// an output file, optionally drawn repeatedly to time the renderer. Filled
+// text is rasterized on the CPU, so it needs no OpenGL context at all.
+int RenderHeadless(int count, char *arguments[])
+{
+   int size = 512;
+   int frames = 0;
+   int first = 0;
+   for (; first + 1 < count && string(arguments[first]).compare(0, 2, "--") == 0; first += 2)
+   {
+      if (string(arguments[first]) == "--size")
+         size = max(1, atoi(arguments[first + 1]));
+      else if (string(arguments[first]) == "--frames")
+         frames = max(0, atoi(arguments[first + 1]));
+      else if (string(arguments[first]) == "--positions")
+         quantizePositions_ = string(arguments[first + 1]) != "float";
+      else if (string(arguments[first]) == "--shaders")
+         separateShaders_ = string(arguments[first + 1]) == "separable";
+      else if (string(arguments[first]) == "--profile")
       {
-         //Load a font file
-         minOffset_ = -13.0f;
-         extractor_.LoadFontFile("fonts/amatic/AmaticSC-Regular.ttf");
+         profileFile_ = arguments[first + 1];
+         profiling_ = true;
       }
+      else
+         break;
+   }
+   if (first == count || (count - first) % 4 != 0) {
+      cout << "Usage: --headless [--size N] [--frames N] [--positions fixed|float] [--shaders linked|separable] [--profile trace.json] <tessellated|elevated|pulled|flattened|filled> <font> <text> <output.png> [...]" << endl;
+      return -1;
+   }
 
-      currTextFont = static_cast<Font>(currTextFont + 1);
-      if (currTextFont == 6)
+   bool needsContext = false;
+   for (int job = first; job < count; job += 4)
+      needsContext = needsContext || string(arguments[job]) != "filled";
+
+   // try for tessellation shaders, falling back to flattening on the CPU
+   OffscreenContext context;
+   MyRenderer renderer;
+   MyFramebuffer framebuffer;
+   if (needsContext)
+   {
+      if (!context.Create(4, 1)) {
+         if (!context.Create(3, 3)) {
+            cout << "Program failed to create an offscreen context, TERMINATING" << endl;
+            return -1;
+         }
+         hasTessellation_ = false;
+      }
+      MarkStartup("context");
+      QueryGLVersion();
+
+      if (!InitializeRenderer(&renderer, OffscreenContext::ProcAddress) || !InitializeFramebuffer(&framebuffer, size, size, 4)) {
+         cout << "Program could not initialize rendering, TERMINATING" << endl;
+         DestroyRenderer(&renderer);
+         DestroyFramebuffer(&framebuffer);
+         return -1;
+      }
+      MarkStartup("renderer");
+   }
+
+   GlyphExtractor extractor;
+   TextLayout layout(extractor);
+   GlyphRasterizer rasterizer;
+   rasterizer.Resize(size, size);
+   vector<unsigned char> pixels;
+   vector<unsigned char> coverage;
+   int result = 0;
+   for (int job = first; job < count; job += 4)
+   {
+      string mode = arguments[job];
+      string font = arguments[job + 1];
+      string text = arguments[job + 2];
+      string output = arguments[job + 3];
+
+      if (mode != "tessellated" && mode != "elevated" && mode != "pulled" && mode != "flattened" && mode != "filled") {
+         cout << "Unknown render mode " << mode << ", skipping " << output << endl;
+         result = -1;
+         continue;
+      }
+      if (!extractor.LoadFontFile(font)) {
+         result = -1;
+         continue;
+      }
+
+      // centre the string, scaled down to fit if it is wider than the image
+      GLfloat width = initFont(layout, text);
+      translation_ = -0.5f * width;
+      scale_ = width > 0.0f ? min(0.9f, 1.9f / width) : 0.9f;
+
+      if (mode == "filled")
       {
-         currTextFont = static_cast<Font>(3);
+         // the same placement as the view transform, in pixels
+         GLfloat pixelsPerEm = scale_ * 0.5f * size;
+         GLfloat x = (translation_ * scale_ + 1.0f) * 0.5f * size;
+         GLfloat y = 0.5f * size;
+
+         chrono::steady_clock::time_point start = chrono::steady_clock::now();
+         for (int i = 0; i < max(frames, 1); i++) {
+            RasterizeText(rasterizer, layout, text, x, y, pixelsPerEm);
+            rasterizer.Rasterize(coverage);
+         }
+         double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+         if (frames > 0)
+            cout << output << ": " << seconds * 1000.0 / frames << " ms/frame over "
+               << frames << " frames" << endl;
+
+         // red text over the same dark grey as the other modes
+         pixels.resize(coverage.size() * 4);
+         for (size_t i = 0; i < coverage.size(); i++) {
+            unsigned char grey = static_cast<unsigned char>(51 * (255 - coverage[i]) / 255);
+            pixels[4 * i + 0] = static_cast<unsigned char>(grey + coverage[i]);
+            pixels[4 * i + 1] = grey;
+            pixels[4 * i + 2] = grey;
+            pixels[4 * i + 3] = 255;
+         }
+         if (!stbi_write_png(output.c_str(), size, size, 4, pixels.data(), size * 4)) {
+            cout << "ERROR: could not write " << output << endl;
+            result = -1;
+            continue;
+         }
+         cout << "Wrote " << output << endl;
+         continue;
+      }
+
+      if (mode != "flattened" && !hasTessellation_)
+         cout << "No tessellation shaders available, flattening " << output << " instead" << endl;
+      flattenCurves_ = mode == "flattened" || !hasTessellation_;
+      elevateCurves_ = mode == "elevated";
+      pullVertices_ = mode == "pulled";
+
+      DrawScene(&renderer, size, size);
+      if (!startup_.reported) {
+         glFinish();
+         MarkStartup("first frame");
+         ReportStartup(false);
+      }
+
+      // time further frames; the geometry is already uploaded, so this
+      // measures drawing alone, with nothing waiting on a display
+      if (frames > 0)
+      {
+         glFinish();
+         chrono::steady_clock::time_point start = chrono::steady_clock::now();
+         for (int i = 0; i < frames; i++)
+            DrawScene(&renderer, size, size);
+         glFinish();
+         double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+         cout << output << ": " << seconds * 1000.0 / frames << " ms/frame over "
+            << frames << " frames" << endl;
+      }
+
+      ReadFramebuffer(&framebuffer, pixels);
+      if (!stbi_write_png(output.c_str(), size, size, 4, pixels.data(), size * 4)) {
+         cout << "ERROR: could not write " << output << endl;
+         result = -1;
+         continue;
       }
+      cout << "Wrote " << output << endl;
    }
-   else if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS)
+
+   if (needsContext)
    {
-      multiplier_ -= 0.2f;
-      if (multiplier_ <= 0)
+      DestroyFramebuffer(&framebuffer);
+      DestroyRenderer(&renderer);
+   }
+   if (profiling_)
+      WriteProfile(profileFile_);
+   return result;
+}
+
+// draws scrolling text into an offscreen framebuffer while switching between
+// the bundled fonts, first loading each font on the drawing thread as it is
+// switched to, as the window once did, then in the background, and reports
+// how long the frames around the switches took in each case
+int BenchmarkFontSwitch(int count, char *arguments[])
+{
+   const int FRAMES_AFTER = 30;
+   const string text = "The quick brown fox jumps over the lazy dog.";
+
+   int size = 512;
+   for (int i = 0; i + 1 < count && string(arguments[i]) == "--size"; i += 2)
+      size = max(1, atoi(arguments[i + 1]));
+
+   OffscreenContext context;
+   MyRenderer renderer;
+   MyFramebuffer framebuffer;
+   if (!context.Create(4, 1)) {
+      if (!context.Create(3, 3)) {
+         cout << "Program failed to create an offscreen context, TERMINATING" << endl;
+         return -1;
+      }
+      hasTessellation_ = false;
+      flattenCurves_ = true;
+   }
+   QueryGLVersion();
+   if (!InitializeRenderer(&renderer, OffscreenContext::ProcAddress) || !InitializeFramebuffer(&framebuffer, size, size, 4)) {
+      cout << "Program could not initialize rendering, TERMINATING" << endl;
+      DestroyRenderer(&renderer);
+      DestroyFramebuffer(&framebuffer);
+      return -1;
+   }
+
+   // both ways should find the font files in the system's file cache
+   {
+      GlyphExtractor extractor;
+      for (int i = 0; i < FONT_COUNT; i++)
+         extractor.LoadFontFile(fontFiles_[i]);
+   }
+
+   for (int background = 0; background < 2; background++)
+   {
+      // each way starts with none of the fonts loaded
+      GlyphExtractor extractor;
+      TextLayout layout(extractor);
+      FontLoader loader;
+      cout << (background ? "Loading in the background:" : "Loading while drawing:") << endl;
+
+      scale_ = 0.90f;
+      offset_ = 1.1f;
+      vector<double> frames;
+      for (int font = 0; font < FONT_COUNT; font++)
       {
-         multiplier_ = 0.1f;
+         double slowest = 0.0, showing = 0.0;
+         int shownAt = -1;
+         for (int frame = 0; shownAt < 0 || frame <= shownAt + FRAMES_AFTER; frame++)
+         {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if (frame == 0 && !background)
+            {
+               extractor.LoadFontFile(fontFiles_[font]);
+               initFont(layout, text);
+               shownAt = 0;
+            }
+            else if (frame == 0)
+               loader.Request(fontFiles_[font], text);
+            if (background && loader.Swap())
+            {
+               initFont(loader.Front().layout, text);
+               shownAt = frame;
+            }
+
+            ScrollText(1, 0.0);
+            DrawScene(&renderer, size, size);
+            glFinish();
+
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            frames.push_back(seconds);
+            slowest = max(slowest, seconds);
+            if (frame == shownAt)
+               showing = seconds;
+         }
+         cout << "  " << fontFiles_[font] << ": shown after " << shownAt << " frames, slowest frame "
+            << slowest * 1000.0 << " ms, the frame showing it " << showing * 1000.0 << " ms" << endl;
       }
+
+      sort(frames.begin(), frames.end());
+      cout << "  " << frames.size() << " frames: median " << frames[frames.size() / 2] * 1000.0
+         << " ms, 99th percentile " << frames[frames.size() * 99 / 100] * 1000.0 << " ms, slowest "
+         << frames.back() * 1000.0 << " ms" << endl;
+
+      // the text and its outlines belong to this way's fonts
+      textLayout_ = 0;
+      textRun_ = 0;
+      DestroyFonts(&renderer);
    }
-   else if (key == GLFW_KEY_LEFT && action == GLFW_PRESS)
+
+   DestroyFramebuffer(&framebuffer);
+   DestroyRenderer(&renderer);
+   return 0;
+}
+
+// builds distance field atlases of the printable ASCII characters, reusing
+// those cached on disk, for the given fonts or every bundled font
+int BuildDistanceFieldAtlases(int count, char *arguments[])
+{
+   float pixelsPerEm = 48.0f;
+   float range = 4.0f;
+   int first = 0;
+   for (; first + 1 < count && string(arguments[first]).compare(0, 2, "--") == 0; first += 2)
    {
-      multiplier_ += 0.2f;
+      if (string(arguments[first]) == "--size")
+         pixelsPerEm = float(max(1, atoi(arguments[first + 1])));
+      else if (string(arguments[first]) == "--range")
+         range = float(max(1.0, atof(arguments[first + 1])));
+      else
+         break;
+   }
+
+   vector<string> fonts(arguments + first, arguments + count);
+   if (fonts.empty())
+      fonts.assign(fontFiles_, fontFiles_ + FONT_COUNT);
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (size_t i = 0; i < fonts.size(); i++)
+   {
+      GlyphExtractor extractor;
+      if (!extractor.LoadFontFile(fonts[i]))
+         return -1;
+
+      chrono::steady_clock::time_point fontStart = chrono::steady_clock::now();
+      DistanceFieldAtlas atlas;
+      string filename = DistanceFieldAtlasFilename(fonts[i]);
+      unsigned long long sourceHash = extractor.Registry().Hash(extractor.CurrentFont());
+      bool cached = atlas.Load(filename, sourceHash, 32, 126, pixelsPerEm, range);
+      if (!cached)
+      {
+         atlas.Generate(extractor, 32, 126, pixelsPerEm, range);
+         if (!atlas.Save(filename))
+            return -1;
+
+         // an image of the atlas, for inspection
+         string image = filename + ".png";
+         stbi_write_png(image.c_str(), atlas.Width(), atlas.Height(), 1,
+            atlas.Pixels().data(), atlas.Width());
+      }
+      double milliseconds = chrono::duration<double>(chrono::steady_clock::now() - fontStart).count() * 1000.0;
+
+      cout << (cached ? "Loaded " : "Generated ") << filename << ": " << atlas.Glyphs().size()
+         << " glyphs in " << atlas.Width() << " x " << atlas.Height() << " texels, "
+         << milliseconds << " ms" << endl;
    }
+   cout << "Total: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000.0
+      << " ms" << endl;
+
+   return 0;
 }
 
 // ==========================================================================
@@ -727,11 +3035,54 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 
 int main(int argc, char *argv[])
 {
+   Profiler::NameThread("main");
+
+   // command-line tools that run without opening a window
+   if (argc > 1 && string(argv[1]) == "--bench-extract")
+      return BenchmarkExtraction(argc > 2 ? argv[2] : "fonts/source-sans-pro/SourceSansPro-Regular.otf");
+   if (argc > 1 && string(argv[1]) == "--pack-font")
+      return PackFonts(argc - 2, argv + 2);
+   if (argc > 1 && string(argv[1]) == "--headless")
+      return RenderHeadless(argc - 2, argv + 2);
+   if (argc > 1 && string(argv[1]) == "--sdf-atlas")
+      return BuildDistanceFieldAtlases(argc - 2, argv + 2);
+   if (argc > 1 && string(argv[1]) == "--bench-marquee")
+      return BenchmarkMarquee(argc - 2, argv + 2);
+   if (argc > 1 && string(argv[1]) == "--bench-font-switch")
+      return BenchmarkFontSwitch(argc - 2, argv + 2);
+
+   // a text file to scroll in place of the text string, how shader
+   // programs are built and where to write a profile
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if (string(argv[i]) == "--marquee")
+      {
+         if (!marquee_.Open(argv[i + 1]))
+            return -1;
+         hasMarquee_ = true;
+      }
+      else if (string(argv[i]) == "--shaders")
+         separateShaders_ = string(argv[i + 1]) == "separable";
+      else if (string(argv[i]) == "--profile")
+      {
+         profileFile_ = argv[i + 1];
+         profiling_ = true;
+      }
+   }
+
+   // open every bundled font and decode its printable ASCII glyphs on worker
+   // threads while the window, context and shaders are made
+   string characters;
+   for (char c = ' '; c <= '~'; c++)
+      characters += c;
+   fontLoader_.Preload(vector<string>(fontFiles_, fontFiles_ + FONT_COUNT), characters);
+
    // initialize the GLFW windowing system
    if (!glfwInit()) {
       cout << "ERROR: GLFW failed to initialize, TERMINATING" << endl;
       return -1;
    }
+   MarkStartup("GLFW");
    glfwSetErrorCallback(ErrorCallback);
 
    // attempt to create a window with an OpenGL 4.1 core profile context
@@ -742,16 +3093,30 @@ int main(int argc, char *argv[])
    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
    glfwWindowHint(GLFW_SAMPLES, 4);
    window = glfwCreateWindow(512, 512, "CPSC 453 OpenGL Assignment 3", 0, 0);
+   if (!window) {
+      // fall back to a 3.3 context, drawing curves flattened on the CPU
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+      window = glfwCreateWindow(512, 512, "CPSC 453 OpenGL Assignment 3", 0, 0);
+      hasTessellation_ = false;
+      flattenCurves_ = true;
+   }
    if (!window) {
       cout << "Program failed to create GLFW window, TERMINATING" << endl;
       glfwTerminate();
       return -1;
    }
+   MarkStartup("window");
 
    // set keyboard callback function and make our context current (active)
    glfwSetKeyCallback(window, KeyCallback);
+   glfwSetFramebufferSizeCallback(window, ResizeCallback);
+   glfwSetWindowRefreshCallback(window, RefreshCallback);
    glfwMakeContextCurrent(window);
 
+   // fonts loaded in the background wake the main loop to be shown
+   fontLoader_.SetNotify(glfwPostEmptyEvent);
+
    //Initialize GLAD
    if (!gladLoadGL())
    {
@@ -759,118 +3124,97 @@ int main(int argc, char *argv[])
       return -1;
    }
 
+   MarkStartup("GL functions");
+
    // query and print out information about our OpenGL environment
    QueryGLVersion();
 
    // call function to load and compile shader programs
-   MyShader lineShader;
-   if (!InitializeShaders(&lineShader)) {
-      cout << "Program could not initialize shaders, TERMINATING" << endl;
-      return -1;
-   }
-
-   MyShader quadraticShader;
-   if (!InitializeShaders(&quadraticShader, "quadraticTessControl.glsl", "quadraticTessEval.glsl")) {
-      cout << "Program could not initialize shaders, TERMINATING" << endl;
-      return -1;
-   }
-
-   MyShader cubicShader;
-   if (!InitializeShaders(&cubicShader, "cubicTessControl.glsl", "cubicTessEval.glsl")) {
+   MyRenderer renderer;
+   if (!InitializeRenderer(&renderer, reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
       cout << "Program could not initialize shaders, TERMINATING" << endl;
       return -1;
    }
-
-   // call function to create and fill buffers with geometry data
-   MyGeometry lineGeometry;
-   MyGeometry quadraticGeometry;
-   MyGeometry cubicGeometry;
+   MarkStartup("renderer");
 
    // Start with quadratic bezier
    initQuadraticControlPoints();
 
-   glPointSize(5.0f);
+   // start synchronized to the display
+   glfwSwapInterval(scheduler_.SwapInterval());
 
    // run an event-triggered main loop
+   chrono::steady_clock::time_point summarized = chrono::steady_clock::now();
    while (!glfwWindowShouldClose(window))
    {
-      // only draw if something changed
-      if (needsRedraw_)
-      {
-         // clear screen to a dark grey colour
-         glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-         glClear(GL_COLOR_BUFFER_BIT);
-
-         // render lines
-         if (pointVertices_.size())
-         {
-            if (!InitializeGeometry(&lineGeometry, pointVertices_, pointColours_))
-               cout << "Program failed to initialize geometry!" << endl;
+      unsigned int objectsBefore = glObjectsCreated_;
+      unsigned int allocationsBefore = glBufferAllocations_;
+      chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
 
-            RenderScene(&lineGeometry, &lineShader, GL_POINTS);
-         }
-
-         // render lines
-         if (lineVertices_.size())
-         {
-            if (!InitializeGeometry(&lineGeometry, lineVertices_, lineColours_))
-               cout << "Program failed to initialize geometry!" << endl;
+      // a font switched to is shown once it has loaded, without waiting
+      bool shown = ShowLoadedText();
 
-            RenderScene(&lineGeometry, &lineShader, GL_LINES);
-         }
+      // scrolling advances by the fixed steps of time that have passed, and
+      // is drawn part of the way into the next
+      if (isScrolling_)
+         scheduler_.Start();
+      else
+         scheduler_.Stop();
+      if (scheduler_.Running())
+      {
+         ScrollText(scheduler_.TakeSteps(), scheduler_.Fraction());
+         needsRedraw_ = true;
+      }
 
-         // render quadratic bezier curves
-         if (quadraticVertices_.size())
+      // only draw, and present, if something changed
+      if (needsRedraw_)
+      {
+         int width, height;
+         glfwGetFramebufferSize(window, &width, &height);
+         DrawScene(&renderer, width, height);
+         TimeSwitchFrame(keySeconds_ + chrono::duration<double>(chrono::steady_clock::now() - frameStart).count(), shown);
+         keySeconds_ = 0.0;
          {
-            if (!InitializeGeometry(&quadraticGeometry, quadraticVertices_, quadraticColours_))
-               cout << "Program failed to initialize geometry!" << endl;
-
-            glPatchParameteri(GL_PATCH_VERTICES, 3);
-            RenderScene(&quadraticGeometry, &quadraticShader, GL_PATCHES);
+            PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
          }
-
-         // render cubic bezier curves
-         if (cubicVertices_.size())
-         {
-            if (!InitializeGeometry(&cubicGeometry, cubicVertices_, cubicColours_))
-               cout << "Program failed to initialize geometry!" << endl;
-
-            glPatchParameteri(GL_PATCH_VERTICES, 4);
-            RenderScene(&cubicGeometry, &cubicShader, GL_PATCHES);
+         if (!startup_.reported) {
+            MarkStartup("first frame");
+            ReportStartup(true);
          }
 
          needsRedraw_ = false;
       }
 
-      if (isScrolling_ == true)
-      {
-         offset_ -= (0.03f * multiplier_);
-         if (offset_ <= minOffset_)
-         {
-            offset_ = 1.1f;
-         }
+      // sleep until there is input when nothing moves; while scrolling, the
+      // swap waits for the display, or without synchronization the next step
+      // is waited for
+      if (!scheduler_.Running())
+         glfwWaitEvents();
+      else if (scheduler_.WaitsForSteps())
+         glfwWaitEventsTimeout(scheduler_.UntilNextStep());
+      else
+         glfwPollEvents();
 
-         initFont(extractor_, "The quick brown fox jumps over the lazy dog.", offset_);
+      // geometry buffers are pooled, so this only reports when a pool is
+      // first created or has to grow
+      if (glObjectsCreated_ != objectsBefore || glBufferAllocations_ != allocationsBefore)
+         cout << "GL objects created this frame: " << glObjectsCreated_ - objectsBefore
+            << ", buffer allocations: " << glBufferAllocations_ - allocationsBefore << endl;
 
-         needsRedraw_ = true;
+      // summaries only cover time in which something was drawn
+      if (profiling_ && chrono::duration<double>(chrono::steady_clock::now() - summarized).count() >= PROFILE_SUMMARY_SECONDS)
+      {
+         Profiler::Summarize(cout);
+         summarized = chrono::steady_clock::now();
       }
-
-      glfwSwapBuffers(window);
-
-      glfwPollEvents();
-
-      DestroyGeometry(&lineGeometry);
-      DestroyGeometry(&quadraticGeometry);
-      DestroyGeometry(&cubicGeometry);
    }
 
    // clean up allocated resources before exit
-   DestroyGeometry(&lineGeometry);
-   DestroyGeometry(&quadraticGeometry);
-   DestroyGeometry(&cubicGeometry);
-   DestroyShaders(&lineShader);
-   DestroyShaders(&quadraticShader);
-   DestroyShaders(&cubicShader);
+   fontLoader_.Stop();
+   DestroyRenderer(&renderer);
+   if (profiling_)
+      WriteProfile(profileFile_);
    glfwDestroyWindow(window);
    glfwTerminate();
 
@@ -944,8 +3288,9 @@ string LoadSource(const string &filename)
    return source;
 }
 
-// creates and returns a shader object compiled from the given source
-GLuint CompileShader(GLenum shaderType, const string &source)
+// creates and returns a shader object compiled from the given source; the
+// result is only checked if asked, as checking waits for the compile
+GLuint CompileShader(GLenum shaderType, const string &source, bool check)
 {
    // allocate shader object name
    GLuint shaderObject = glCreateShader(shaderType);
@@ -955,6 +3300,15 @@ GLuint CompileShader(GLenum shaderType, const string &source)
    glShaderSource(shaderObject, 1, &source_ptr, 0);
    glCompileShader(shaderObject);
 
+   if (check)
+      CheckShader(shaderObject, source);
+   return shaderObject;
+}
+
+// reports the errors compiling a shader object from the given source,
+// returning true if it compiled
+bool CheckShader(GLuint shaderObject, const string &source)
+{
    // retrieve compile status
    GLint status;
    glGetShaderiv(shaderObject, GL_COMPILE_STATUS, &status);
@@ -969,53 +3323,22 @@ GLuint CompileShader(GLenum shaderType, const string &source)
       cout << info << endl;
    }
 
-   return shaderObject;
+   return status == GL_TRUE;
 }
 
-// creates and returns a program object linked from vertex, tcs, tes and fragment shaders
-GLuint LinkProgram(GLuint vertexShader, GLuint TCSshader, GLuint TESshader, GLuint fragmentShader)
+// links a program object from the shader objects attached to it, returning
+// true if successful; unchecked, it returns true without waiting for the link
+bool LinkProgram(GLuint programObject, bool check)
 {
-   // allocate program object name
-   GLuint programObject = glCreateProgram();
-
-   // attach provided shader objects to this program
-   if (vertexShader)   glAttachShader(programObject, vertexShader);
-   if (TCSshader) glAttachShader(programObject, TCSshader);
-   if (TESshader) glAttachShader(programObject, TESshader);
-   if (fragmentShader) glAttachShader(programObject, fragmentShader);
-
-   // try linking the program with given attachments
+   // try linking the program with its attachments
    glLinkProgram(programObject);
 
-   // retrieve link status
-   GLint status;
-   glGetProgramiv(programObject, GL_LINK_STATUS, &status);
-   if (status == GL_FALSE)
-   {
-      GLint length;
-      glGetProgramiv(programObject, GL_INFO_LOG_LENGTH, &length);
-      string info(length, ' ');
-      glGetProgramInfoLog(programObject, info.length(), &length, &info[0]);
-      cout << "ERROR linking shader program:" << endl;
-      cout << info << endl;
-   }
-
-   return programObject;
+   return !check || CheckProgram(programObject);
 }
 
-// creates and returns a program object linked from vertex and fragment shaders
-GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader)
+// reports the errors linking a program object, returning true if it linked
+bool CheckProgram(GLuint programObject)
 {
-   // allocate program object name
-   GLuint programObject = glCreateProgram();
-
-   // attach provided shader objects to this program
-   if (vertexShader)   glAttachShader(programObject, vertexShader);
-   if (fragmentShader) glAttachShader(programObject, fragmentShader);
-
-   // try linking the program with given attachments
-   glLinkProgram(programObject);
-
    // retrieve link status
    GLint status;
    glGetProgramiv(programObject, GL_LINK_STATUS, &status);
@@ -1029,5 +3352,5 @@ GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader)
       cout << info << endl;
    }
 
-   return programObject;
-}
\ No newline at end of file
+   return status == GL_TRUE;
+}
@@ -5,13 +5,40 @@ layout(vertices = 4) out; //How long gl_out[] should be
 in vec3 Colour[];
 out vec3 teColour[];
 
+// framebuffer size in pixels, and the largest allowed distance in pixels
+// between the curve and the lines drawn for it
+uniform vec2 ViewportSize;
+uniform float Tolerance;
+
+// subdivides every patch this many times if positive, instead of adapting
+uniform int FixedLevel;
+
+// subdivision level for this patch, from its size and flatness on screen
+float AdaptiveLevel()
+{
+    vec2 p[4];
+    for (int i = 0; i < 4; ++i)
+        p[i] = gl_in[i].gl_Position.xy / gl_in[i].gl_Position.w * 0.5 * ViewportSize;
+
+    // the chord error of n equal steps along a cubic is at most
+    // 3 max(|p0 - 2 p1 + p2|, |p1 - 2 p2 + p3|) / (4 n^2)
+    float curvature = max(length(p[0] - 2.0 * p[1] + p[2]), length(p[1] - 2.0 * p[2] + p[3]));
+    float pieces = sqrt(3.0 * curvature / (4.0 * Tolerance));
+
+    // control polygon length bounds the curve length on screen
+    float len = distance(p[0], p[1]) + distance(p[1], p[2]) + distance(p[2], p[3]);
+
+    // never split finer than about two pixels per piece
+    return clamp(ceil(pieces), 1.0, clamp(ceil(len / 2.0), 1.0, 64.0));
+}
+
 void main()
 {
 
     // gl_InvocationID tells you what input vertex you are working on
     if (gl_InvocationID == 0) {   // only needs to be set once
         gl_TessLevelOuter[0] = 1; // How many lines to draw
-        gl_TessLevelOuter[1] = 30; // how much to subdivide each line
+        gl_TessLevelOuter[1] = FixedLevel > 0 ? float(FixedLevel) : AdaptiveLevel(); // how much to subdivide each line
     }
 
     gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;	// pass control points to TES
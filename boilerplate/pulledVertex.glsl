@@ -0,0 +1,58 @@
+// ==========================================================================
+// Vertex program that pulls glyph outlines from buffer textures
+//
+// Draws every segment as a cubic patch of four vertices. Nothing is stored
+// per vertex: gl_VertexID picks the segment and which of its controls this
+// is, and lines and quadratics are raised to the cubic that traces them.
+// ==========================================================================
+#version 410
+
+// the packed outlines of a font, uploaded as extracted: x,y pairs, the first
+// point of each segment, and the degree of each segment
+uniform samplerBuffer Points;
+uniform usamplerBuffer Segments;
+uniform usamplerBuffer Degrees;
+
+// colour of the whole draw, and where this instance of a glyph sits in its
+// text run; attribute locations match those of the main vertex program
+layout(location = 1) in vec3 VertexColour;
+layout(location = 2) in vec2 InstanceOffset;
+
+// view transform
+uniform float Translation;
+uniform float Scale;
+
+// output to be interpolated between vertices and passed to the next stage
+out vec3 Colour;
+
+// control j of the cubic that exactly traces a segment of the given degree
+vec2 ElevatedControl(int first, int degree, int j)
+{
+    vec2 start = texelFetch(Points, first).xy;
+    vec2 end = texelFetch(Points, first + degree).xy;
+    if (j == 0 || degree == 0)
+        return start;
+    if (j == 3)
+        return end;
+
+    if (degree == 1)
+        return j == 1 ? start + (end - start) / 3.0 : start + 2.0 * (end - start) / 3.0;
+    if (degree == 2) {
+        vec2 control = texelFetch(Points, first + 1).xy;
+        return j == 1 ? start + 2.0 * (control - start) / 3.0 : end + 2.0 * (control - end) / 3.0;
+    }
+    return texelFetch(Points, first + j).xy;
+}
+
+void main()
+{
+    int segment = gl_VertexID / 4;
+    int first = int(texelFetch(Segments, segment).r);
+    int degree = int(texelFetch(Degrees, segment).r);
+    vec2 position = ElevatedControl(first, degree, gl_VertexID % 4);
+
+    // place the instance, translate horizontally, then scale about the origin
+    gl_Position = vec4((position + InstanceOffset + vec2(Translation, 0.0)) * Scale, 0.0, 1.0);
+
+    Colour = VertexColour;
+}
@@ -11,13 +11,25 @@
 layout(location = 0) in vec2 VertexPosition;
 layout(location = 1) in vec3 VertexColour;
 
+// where this instance of a glyph sits in its text run; attributes that are
+// not enabled read as zero, so other geometry is drawn where it is
+layout(location = 2) in vec2 InstanceOffset;
+
+// view transform: geometry is uploaded once and moved by these, so scrolling
+// costs a uniform update instead of rebuilding and re-uploading every vertex
+uniform float Translation;
+uniform float Scale;
+
+// positions may be stored as integers, in units of this many EM
+uniform float PositionScale;
+
 // output to be interpolated between vertices and passed to the fragment stage
 out vec3 Colour;
 
 void main()
 {
-    // assign vertex position without modification
-    gl_Position = vec4(VertexPosition, 0.0, 1.0);
+    // place the instance, translate horizontally, then scale about the origin
+    gl_Position = vec4((VertexPosition * PositionScale + InstanceOffset + vec2(Translation, 0.0)) * Scale, 0.0, 1.0);
 
     // assign output colour to be interpolated
     Colour = VertexColour;